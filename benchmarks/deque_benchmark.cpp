@@ -0,0 +1,146 @@
+// g++ -std=c++20 -O2 -DNDEBUG deque_benchmark.cpp -lbenchmark -lpthread
+#include <benchmark/benchmark.h>
+
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "../deque.cpp"
+
+namespace {
+
+// push_back/pop_front at a steady queue length
+template <typename Container>
+void BM_FifoChurn(benchmark::State& state) {
+  Container queue;
+  const size_t length = state.range(0);
+  for (size_t i = 0; i < length; ++i) {
+    queue.push_back(i);
+  }
+  size_t next = length;
+  for (auto _ : state) {
+    queue.push_back(next++);
+    benchmark::DoNotOptimize(*queue.begin());
+    queue.pop_front();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_FifoChurn, Deque<size_t>)->Range(64, 1 << 20);
+BENCHMARK_TEMPLATE(BM_FifoChurn, std::deque<size_t>)->Range(64, 1 << 20);
+
+template <typename Container>
+void BM_RandomAccess(benchmark::State& state) {
+  Container deque;
+  const size_t length = state.range(0);
+  for (size_t i = 0; i < length; ++i) {
+    deque.push_back(i);
+  }
+  std::minstd_rand random(42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(deque[random() % length]);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+// 4 KiB, 256 KiB, 8 MiB and 128 MiB of elements
+BENCHMARK_TEMPLATE(BM_RandomAccess, Deque<size_t>)
+    ->Arg(512)
+    ->Arg(32 << 10)
+    ->Arg(1 << 20)
+    ->Arg(16 << 20);
+BENCHMARK_TEMPLATE(BM_RandomAccess, std::deque<size_t>)
+    ->Arg(512)
+    ->Arg(32 << 10)
+    ->Arg(1 << 20)
+    ->Arg(16 << 20);
+
+template <typename Container>
+void BM_SequentialScan(benchmark::State& state) {
+  Container deque;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    deque.push_back(i);
+  }
+  for (auto _ : state) {
+    size_t sum = 0;
+    for (auto value : deque) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_SequentialScan, Deque<size_t>)->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_SequentialScan, std::deque<size_t>)
+    ->Range(1 << 10, 1 << 22);
+
+template <typename Container>
+void BM_MiddleInsert(benchmark::State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    Container deque;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      deque.push_back(i);
+    }
+    state.ResumeTiming();
+    deque.insert(deque.begin() + deque.size() / 3, 64, size_t{0});
+    benchmark::DoNotOptimize(deque.size());
+  }
+}
+BENCHMARK_TEMPLATE(BM_MiddleInsert, Deque<size_t>)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_MiddleInsert, std::deque<size_t>)
+    ->Range(1 << 10, 1 << 18);
+
+// hand-off between two threads, the baseline is a mutex around std::deque
+template <typename Queue>
+void run_handoff(Queue& queue, size_t count) {
+  std::thread producer([&] {
+    for (size_t i = 0; i < count; ++i) {
+      queue.push(i);
+    }
+  });
+  size_t value;
+  for (size_t received = 0; received < count;) {
+    if (queue.try_pop(value)) {
+      ++received;
+    }
+  }
+  producer.join();
+}
+
+struct LockedQueue {
+  void push(size_t value) {
+    std::lock_guard lock(mutex);
+    queue.push_back(value);
+  }
+
+  bool try_pop(size_t& value) {
+    std::lock_guard lock(mutex);
+    if (queue.empty()) {
+      return false;
+    }
+    value = queue.front();
+    queue.pop_front();
+    return true;
+  }
+
+  std::mutex mutex;
+  std::deque<size_t> queue;
+};
+
+template <typename Queue>
+void BM_SpscHandoff(benchmark::State& state) {
+  const size_t count = state.range(0);
+  for (auto _ : state) {
+    Queue queue;
+    run_handoff(queue, count);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_SpscHandoff, SpscQueue<size_t>)
+    ->Arg(1 << 20)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SpscHandoff, LockedQueue)->Arg(1 << 20)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,159 @@
+// g++ -std=c++20 -O2 -DNDEBUG list_and_stack_allocator_benchmark.cpp -lbenchmark -lpthread
+#include <benchmark/benchmark.h>
+
+#include <list>
+
+#include "../list_and_stack_allocator.cpp"
+
+namespace {
+
+constexpr size_t arena_size = 64 << 20;
+
+void BM_PushBackStdAllocator(benchmark::State& state) {
+  for (auto _ : state) {
+    List<int> list;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      list.push_back(i);
+    }
+    benchmark::DoNotOptimize(list.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PushBackStdAllocator)->Range(1 << 8, 1 << 18);
+
+void BM_PushBackStackAllocator(benchmark::State& state) {
+  static StackStorage<arena_size> storage;
+  StackAllocator<int, arena_size> allocator(storage);
+  for (auto _ : state) {
+    {
+      List<int, StackAllocator<int, arena_size>> list(allocator);
+      for (int64_t i = 0; i < state.range(0); ++i) {
+        list.push_back(i);
+      }
+      benchmark::DoNotOptimize(list.size());
+    }
+    storage.reset();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PushBackStackAllocator)->Range(1 << 8, 1 << 18);
+
+void BM_PushBackStdList(benchmark::State& state) {
+  for (auto _ : state) {
+    std::list<int> list;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      list.push_back(i);
+    }
+    benchmark::DoNotOptimize(list.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PushBackStdList)->Range(1 << 8, 1 << 18);
+
+void BM_PushBackStdListStackAllocator(benchmark::State& state) {
+  static StackStorage<arena_size> storage;
+  StackAllocator<int, arena_size> allocator(storage);
+  for (auto _ : state) {
+    {
+      std::list<int, StackAllocator<int, arena_size>> list(allocator);
+      for (int64_t i = 0; i < state.range(0); ++i) {
+        list.push_back(i);
+      }
+      benchmark::DoNotOptimize(list.size());
+    }
+    storage.reset();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PushBackStdListStackAllocator)->Range(1 << 8, 1 << 18);
+
+// a long-lived list with steady insert/erase, the case StackAllocator
+// cannot serve because it never reuses memory
+template <typename ListType>
+void churn(benchmark::State& state, ListType& list) {
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    list.push_back(i);
+  }
+  for (auto _ : state) {
+    list.push_back(0);
+    list.pop_front();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ChurnStdAllocator(benchmark::State& state) {
+  List<int> list;
+  churn(state, list);
+}
+BENCHMARK(BM_ChurnStdAllocator)->Arg(1 << 10)->Arg(1 << 16);
+
+void BM_ChurnPoolAllocator(benchmark::State& state) {
+  PoolStorage<> storage;
+  List<int, PoolAllocator<int>> list{PoolAllocator<int>(storage)};
+  churn(state, list);
+}
+BENCHMARK(BM_ChurnPoolAllocator)->Arg(1 << 10)->Arg(1 << 16);
+
+void BM_ChurnStdList(benchmark::State& state) {
+  std::list<int> list;
+  churn(state, list);
+}
+BENCHMARK(BM_ChurnStdList)->Arg(1 << 10)->Arg(1 << 16);
+
+// the code around the timed loop is not behind the barrier, so the storage
+// is shared by all runs and outlives every thread's list
+void BM_ChurnCachedPoolThreads(benchmark::State& state) {
+  static CachedPoolStorage<> storage;
+  CachedPoolAllocator<int> allocator(storage);
+  List<int, CachedPoolAllocator<int>> list(allocator);
+  churn(state, list);
+}
+BENCHMARK(BM_ChurnCachedPoolThreads)
+    ->Arg(1 << 10)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+void BM_ChurnStdAllocatorThreads(benchmark::State& state) {
+  List<int> list;
+  churn(state, list);
+}
+BENCHMARK(BM_ChurnStdAllocatorThreads)
+    ->Arg(1 << 10)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+void BM_Traverse(benchmark::State& state) {
+  List<int> list;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    list.push_back(i);
+  }
+  for (auto _ : state) {
+    long sum = 0;
+    for (int value : list) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Traverse)->Range(1 << 10, 1 << 20);
+
+void BM_TraverseStdList(benchmark::State& state) {
+  std::list<int> list;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    list.push_back(i);
+  }
+  for (auto _ : state) {
+    long sum = 0;
+    for (int value : list) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TraverseStdList)->Range(1 << 10, 1 << 20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
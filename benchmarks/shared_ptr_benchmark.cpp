@@ -0,0 +1,208 @@
+// g++ -std=c++20 -O2 -DNDEBUG shared_ptr_benchmark.cpp -lbenchmark -lpthread
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include "../shared_ptr.cpp"
+
+namespace {
+
+struct Message {
+  int payload[4] = {};
+};
+
+struct CountedMessage : RefCounted<CountedMessage, MultiThreaded> {
+  int payload[4] = {};
+};
+
+void BM_MakeShared(benchmark::State& state) {
+  for (auto _ : state) {
+    auto ptr = makeShared<Message>();
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+BENCHMARK(BM_MakeShared);
+
+void BM_AllocateSharedPooled(benchmark::State& state) {
+  for (auto _ : state) {
+    auto ptr = allocateShared<Message>(PooledAllocator<Message>());
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+BENCHMARK(BM_AllocateSharedPooled);
+
+// creation and teardown of a whole batch, per object
+void BM_MakeSharedBatch(benchmark::State& state) {
+  for (auto _ : state) {
+    auto batch = makeSharedBatch<Message>(state.range(0));
+    benchmark::DoNotOptimize(batch.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MakeSharedBatch)->Arg(64)->Arg(4096);
+
+void BM_MakeSharedLoop(benchmark::State& state) {
+  for (auto _ : state) {
+    std::vector<SharedPtr<Message>> batch;
+    batch.reserve(state.range(0));
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      batch.push_back(makeShared<Message>());
+    }
+    benchmark::DoNotOptimize(batch.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MakeSharedLoop)->Arg(64)->Arg(4096);
+
+void BM_MakeSharedStd(benchmark::State& state) {
+  for (auto _ : state) {
+    auto ptr = std::make_shared<Message>();
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+BENCHMARK(BM_MakeSharedStd);
+
+void BM_MakeIntrusive(benchmark::State& state) {
+  for (auto _ : state) {
+    auto ptr = makeIntrusive<CountedMessage>();
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+BENCHMARK(BM_MakeIntrusive);
+
+template <typename Ptr>
+void dereference(benchmark::State& state, const Ptr& ptr) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ptr->payload[0]);
+  }
+}
+
+void BM_Dereference(benchmark::State& state) {
+  dereference(state, makeShared<Message>());
+}
+BENCHMARK(BM_Dereference);
+
+void BM_DereferenceStd(benchmark::State& state) {
+  dereference(state, std::make_shared<Message>());
+}
+BENCHMARK(BM_DereferenceStd);
+
+// every thread copies the same pointer, so the count's cache line bounces
+template <typename Ptr>
+void copy_shared(benchmark::State& state, const Ptr& ptr) {
+  for (auto _ : state) {
+    Ptr copy = ptr;
+    benchmark::DoNotOptimize(copy.get());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_CopySingleThreaded(benchmark::State& state) {
+  static auto ptr = makeShared<Message>();
+  copy_shared(state, ptr);
+}
+BENCHMARK(BM_CopySingleThreaded);
+
+void BM_CopyMultiThreaded(benchmark::State& state) {
+  static auto ptr = makeShared<Message, MultiThreaded>();
+  copy_shared(state, ptr);
+}
+BENCHMARK(BM_CopyMultiThreaded)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_CopyStd(benchmark::State& state) {
+  static auto ptr = std::make_shared<Message>();
+  copy_shared(state, ptr);
+}
+BENCHMARK(BM_CopyStd)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_CopyIntrusive(benchmark::State& state) {
+  static auto ptr = makeIntrusive<CountedMessage>();
+  copy_shared(state, ptr);
+}
+BENCHMARK(BM_CopyIntrusive)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_MoveSharedPtr(benchmark::State& state) {
+  auto first = makeShared<Message>();
+  SharedPtr<Message> second;
+  for (auto _ : state) {
+    second = std::move(first);
+    first = std::move(second);
+    benchmark::DoNotOptimize(first.get());
+  }
+}
+BENCHMARK(BM_MoveSharedPtr);
+
+void BM_MoveStd(benchmark::State& state) {
+  auto first = std::make_shared<Message>();
+  std::shared_ptr<Message> second;
+  for (auto _ : state) {
+    second = std::move(first);
+    first = std::move(second);
+    benchmark::DoNotOptimize(first.get());
+  }
+}
+BENCHMARK(BM_MoveStd);
+
+template <typename Weak>
+void lock_weak(benchmark::State& state, const Weak& weak) {
+  for (auto _ : state) {
+    auto locked = weak.lock();
+    benchmark::DoNotOptimize(locked.get());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_WeakLockMultiThreaded(benchmark::State& state) {
+  static auto ptr = makeShared<Message, MultiThreaded>();
+  static WeakPtr<Message, MultiThreaded> weak = ptr;
+  lock_weak(state, weak);
+}
+BENCHMARK(BM_WeakLockMultiThreaded)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_WeakLockStd(benchmark::State& state) {
+  static auto ptr = std::make_shared<Message>();
+  static std::weak_ptr<Message> weak = ptr;
+  lock_weak(state, weak);
+}
+BENCHMARK(BM_WeakLockStd)->ThreadRange(1, 8)->UseRealTime();
+
+template <typename Policy>
+struct GraphNode {
+  SharedPtr<GraphNode, Policy> children[4];
+};
+
+template <typename Policy>
+SharedPtr<GraphNode<Policy>, Policy> make_graph(int depth) {
+  auto node = makeShared<GraphNode<Policy>, Policy>();
+  if (depth > 0) {
+    for (auto& child : node->children) {
+      child = make_graph<Policy>(depth - 1);
+    }
+  }
+  return node;
+}
+
+// what the thread dropping the last reference to a graph of 5461 nodes
+// pays; with DeferredRelease the destructors run on the background thread
+template <typename Policy>
+void BM_ReleaseGraph(benchmark::State& state) {
+  if constexpr (std::is_same_v<Policy, DeferredRelease>) {
+    Reclaimer::start_background();
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto graph = make_graph<Policy>(6);
+    state.ResumeTiming();
+    graph = SharedPtr<GraphNode<Policy>, Policy>();
+  }
+  if constexpr (std::is_same_v<Policy, DeferredRelease>) {
+    Reclaimer::stop_background();
+  }
+}
+BENCHMARK_TEMPLATE(BM_ReleaseGraph, MultiThreaded);
+BENCHMARK_TEMPLATE(BM_ReleaseGraph, DeferredRelease);
+
+}  // namespace
+
+BENCHMARK_MAIN();
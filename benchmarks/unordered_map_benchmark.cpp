@@ -0,0 +1,287 @@
+// g++ -std=c++20 -O2 -DNDEBUG unordered_map_benchmark.cpp -lbenchmark -lpthread
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../unordered_map.cpp"
+
+namespace {
+
+std::vector<uint64_t> make_keys(size_t count, uint64_t seed) {
+  std::mt19937_64 random(seed);
+  std::vector<uint64_t> keys(count);
+  for (auto& key : keys) {
+    key = random();
+  }
+  return keys;
+}
+
+using PowerOfTwoMap =
+    UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>,
+                 std::equal_to<uint64_t>,
+                 std::allocator<std::pair<const uint64_t, uint64_t>>,
+                 PowerOfTwoBuckets>;
+
+// about 32 bytes per entry, so the arguments span L1, L2, L3 and DRAM
+#define MAP_SIZES Arg(1 << 10)->Arg(1 << 13)->Arg(1 << 17)->Arg(1 << 22)
+
+template <typename Map>
+void BM_LookupHit(benchmark::State& state) {
+  auto keys = make_keys(state.range(0), 1);
+  Map map;
+  for (auto key : keys) {
+    map.emplace(key, key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(2));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(keys[i]));
+    i = i + 1 == keys.size() ? 0 : i + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LookupHit, UnorderedMap<uint64_t, uint64_t>)->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_LookupHit, PowerOfTwoMap)->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_LookupHit, FlatUnorderedMap<uint64_t, uint64_t>)
+    ->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_LookupHit, std::unordered_map<uint64_t, uint64_t>)
+    ->MAP_SIZES;
+
+template <typename Map>
+void BM_LookupMiss(benchmark::State& state) {
+  auto keys = make_keys(state.range(0), 1);
+  auto missing = make_keys(state.range(0), 3);
+  Map map;
+  for (auto key : keys) {
+    map.emplace(key, key);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(missing[i]));
+    i = i + 1 == missing.size() ? 0 : i + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LookupMiss, UnorderedMap<uint64_t, uint64_t>)->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_LookupMiss, FlatUnorderedMap<uint64_t, uint64_t>)
+    ->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_LookupMiss, std::unordered_map<uint64_t, uint64_t>)
+    ->MAP_SIZES;
+
+// keys that differ only above their low 12 bits, with std::hash as the
+// identity these pile into a few buckets unless the bucket index is mixed
+template <typename Map>
+void BM_LookupStrided(benchmark::State& state) {
+  std::vector<uint64_t> keys(state.range(0));
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = i << 12;
+  }
+  Map map;
+  for (auto key : keys) {
+    map.emplace(key, key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(2));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(keys[i]));
+    i = i + 1 == keys.size() ? 0 : i + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_LookupStrided, UnorderedMap<uint64_t, uint64_t>)
+    ->Arg(1 << 15);
+BENCHMARK_TEMPLATE(BM_LookupStrided, PowerOfTwoMap)->Arg(1 << 15);
+BENCHMARK_TEMPLATE(BM_LookupStrided, std::unordered_map<uint64_t, uint64_t>)
+    ->Arg(1 << 15);
+
+// the same probes as BM_LookupHit issued through find_batch
+void BM_FindBatch(benchmark::State& state) {
+  auto keys = make_keys(state.range(0), 1);
+  UnorderedMap<uint64_t, uint64_t> map;
+  for (auto key : keys) {
+    map.emplace(key, key);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(2));
+  std::vector<UnorderedMap<uint64_t, uint64_t>::iterator> found;
+  found.reserve(keys.size());
+  for (auto _ : state) {
+    found.clear();
+    map.find_batch(std::span<const uint64_t>(keys), std::back_inserter(found));
+    benchmark::DoNotOptimize(found.data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_FindBatch)->MAP_SIZES;
+
+template <typename Map>
+void BM_Insert(benchmark::State& state) {
+  auto keys = make_keys(state.range(0), 1);
+  for (auto _ : state) {
+    Map map;
+    for (auto key : keys) {
+      map.emplace(key, key);
+    }
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_Insert, UnorderedMap<uint64_t, uint64_t>)->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_Insert, FlatUnorderedMap<uint64_t, uint64_t>)
+    ->MAP_SIZES;
+BENCHMARK_TEMPLATE(BM_Insert, std::unordered_map<uint64_t, uint64_t>)
+    ->MAP_SIZES;
+
+// arguments are the size and the worker count, 1 is the single-thread cost
+// of the bulk path against BM_Insert
+void BM_InsertParallel(benchmark::State& state) {
+  auto keys = make_keys(state.range(0), 1);
+  std::vector<std::pair<const uint64_t, uint64_t>> nodes;
+  nodes.reserve(keys.size());
+  for (auto key : keys) {
+    nodes.emplace_back(key, key);
+  }
+  for (auto _ : state) {
+    UnorderedMap<uint64_t, uint64_t> map;
+    map.insert_parallel(nodes, state.range(1));
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_InsertParallel)
+    ->ArgsProduct({{1 << 17, 1 << 22}, {1, 2, 4, 8}})
+    ->UseRealTime();
+
+using RobinHoodMap =
+    FlatUnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>,
+                     std::equal_to<uint64_t>,
+                     std::allocator<std::pair<const uint64_t, uint64_t>>,
+                     RobinHoodProbing>;
+
+// erases every other entry while iterating over a 32-slot table filled
+// to its load limit, where clusters often wrap around the end; doubles as
+// a check that every key is visited exactly once and that lookups after
+// the backward shifts find exactly the keys left
+void BM_EraseWhileIterating(benchmark::State& state) {
+  std::mt19937_64 random(4);
+  std::vector<uint64_t> keys;
+  for (auto _ : state) {
+    RobinHoodMap map;
+    keys.clear();
+    while (map.size() < 24) {
+      uint64_t key = random() % 1000;
+      if (map.emplace(key, 0).second) {
+        keys.push_back(key);
+      }
+    }
+    size_t visited = 0;
+    for (auto it = map.begin(); it != map.end(); ++visited) {
+      if (++it->second != 1) {
+        state.SkipWithError("an entry was visited twice");
+        return;
+      }
+      it = visited % 2 == 0 ? map.erase(it) : std::next(it);
+    }
+    if (visited != keys.size()) {
+      state.SkipWithError("an entry was skipped");
+      return;
+    }
+    size_t found = 0;
+    for (auto key : keys) {
+      found += map.find(key) != map.end();
+    }
+    // putting every key back must not duplicate one that was left
+    for (auto key : keys) {
+      map.emplace(key, 0);
+    }
+    if (found != keys.size() - (keys.size() + 1) / 2 ||
+        map.size() != keys.size()) {
+      state.SkipWithError("a lookup after erase went wrong");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EraseWhileIterating);
+
+template <typename Map>
+void BM_StringLookup(benchmark::State& state) {
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    keys.push_back("request/route/" + std::to_string(i * 7919));
+  }
+  Map map;
+  for (const auto& key : keys) {
+    map.emplace(key, 0);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(keys[i]));
+    i = i + 1 == keys.size() ? 0 : i + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_StringLookup, UnorderedMap<std::string, int>)
+    ->Arg(1 << 10)
+    ->Arg(1 << 17);
+BENCHMARK_TEMPLATE(BM_StringLookup, std::unordered_map<std::string, int>)
+    ->Arg(1 << 10)
+    ->Arg(1 << 17);
+
+// the baseline is what ConcurrentUnorderedMap replaces, one global mutex
+struct LockedMap {
+  bool try_emplace(uint64_t key, uint64_t value) {
+    std::lock_guard lock(mutex);
+    return map.try_emplace(key, value).second;
+  }
+
+  std::optional<uint64_t> find(uint64_t key) const {
+    std::lock_guard lock(mutex);
+    auto it = map.find(key);
+    if (it == map.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  mutable std::mutex mutex;
+  std::unordered_map<uint64_t, uint64_t> map;
+};
+
+template <typename Map>
+void BM_ConcurrentLookup(benchmark::State& state) {
+  // set up by the first thread before the start barrier
+  static Map* map = nullptr;
+  static std::vector<uint64_t> keys;
+  if (state.thread_index() == 0) {
+    keys = make_keys(1 << 17, 1);
+    map = new Map();
+    for (auto key : keys) {
+      map->try_emplace(key, key);
+    }
+  }
+  size_t i = state.thread_index() * 7919;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map->find(keys[i % keys.size()]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    delete map;
+  }
+}
+BENCHMARK_TEMPLATE(BM_ConcurrentLookup,
+                   ConcurrentUnorderedMap<uint64_t, uint64_t>)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentLookup, LockedMap)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,144 @@
+// g++ -std=c++20 -O2 -DNDEBUG variant_benchmark.cpp -lbenchmark -lpthread
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "../variant.cpp"
+
+namespace {
+
+template <size_t I>
+struct Packet {
+  int value = I;
+};
+
+template <template <typename...> typename VariantType, size_t... I>
+auto make_packets(std::index_sequence<I...>) {
+  using Element = VariantType<Packet<I>...>;
+  constexpr size_t count = sizeof...(I);
+  std::mt19937 random(7);
+  std::vector<Element> packets;
+  packets.reserve(1 << 12);
+  for (size_t i = 0; i < (1 << 12); ++i) {
+    size_t kind = random() % count;
+    ((kind == I ? void(packets.emplace_back(Packet<I>())) : void()), ...);
+  }
+  return packets;
+}
+
+struct Handler {
+  template <size_t I>
+  int operator()(const Packet<I>& packet) const {
+    return packet.value * static_cast<int>(I + 1);
+  }
+};
+
+// a message dispatcher over 24 packet kinds in random order
+template <template <typename...> typename VariantType>
+void BM_Dispatch24(benchmark::State& state) {
+  auto packets = make_packets<VariantType>(std::make_index_sequence<24>());
+  for (auto _ : state) {
+    int sum = 0;
+    for (const auto& packet : packets) {
+      // std::visit for std::variant, ::visit is found by ADL for Variant
+      using std::visit;
+      sum += visit(Handler(), packet);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * packets.size());
+}
+BENCHMARK_TEMPLATE(BM_Dispatch24, Variant);
+BENCHMARK_TEMPLATE(BM_Dispatch24, std::variant);
+
+template <template <typename...> typename VariantType>
+void BM_DoubleVisit(benchmark::State& state) {
+  using Element = VariantType<int, double, char>;
+  std::vector<Element> values{1, 2.0, 'c', 4, 5.0, 'f', 7, 8.0};
+  auto add = [](auto lhs, auto rhs) { return static_cast<double>(lhs + rhs); };
+  for (auto _ : state) {
+    double sum = 0;
+    for (size_t i = 0; i + 1 < values.size(); ++i) {
+      using std::visit;
+      sum += visit(add, values[i], values[i + 1]);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+}
+BENCHMARK_TEMPLATE(BM_DoubleVisit, Variant);
+BENCHMARK_TEMPLATE(BM_DoubleVisit, std::variant);
+
+template <typename Element>
+void BM_CopyColumn(benchmark::State& state) {
+  std::vector<Element> column(state.range(0), Element(1));
+  for (auto _ : state) {
+    auto copy = column;
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          sizeof(Element));
+}
+BENCHMARK_TEMPLATE(BM_CopyColumn, Variant<int, float, double>)
+    ->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_CopyColumn, std::variant<int, float, double>)
+    ->Range(1 << 10, 1 << 20);
+
+// mostly int with an occasional string, summed by type
+void BM_SumVariantVector(benchmark::State& state) {
+  std::vector<Variant<int, std::string>> column;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    if (i % 64 == 0) {
+      column.emplace_back(std::string("note"));
+    } else {
+      column.emplace_back(static_cast<int>(i));
+    }
+  }
+  for (auto _ : state) {
+    long sum = 0;
+    for (const auto& value : column) {
+      sum += visit(
+          [](const auto& item) -> long {
+            if constexpr (std::is_same_v<std::decay_t<decltype(item)>, int>) {
+              return item;
+            } else {
+              return static_cast<long>(item.size());
+            }
+          },
+          value);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SumVariantVector)->Range(1 << 10, 1 << 20);
+
+void BM_SumVariantColumn(benchmark::State& state) {
+  VariantColumn<int, std::string> column;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    if (i % 64 == 0) {
+      column.push_back(std::string("note"));
+    } else {
+      column.push_back(static_cast<int>(i));
+    }
+  }
+  for (auto _ : state) {
+    long sum = 0;
+    column.visit_batch([&sum](const auto& item) {
+      if constexpr (std::is_same_v<std::decay_t<decltype(item)>, int>) {
+        sum += item;
+      } else {
+        sum += static_cast<long>(item.size());
+      }
+    });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SumVariantColumn)->Range(1 << 10, 1 << 20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -1,8 +1,134 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// by default a chunk holds as many elements as fit into 4 KiB
 template <typename T>
+inline constexpr size_t default_chunk_size =
+    std::max<size_t>(4096 / sizeof(T), 1);
+
+// a read-only view of a deque snapshot, meant for a file mapped with mmap;
+// a header is followed by the elements in order, so the view is usable at
+// any address and indexing is a plain array access
+template <typename T>
+class MappedDeque {
+ public:
+  // bytes must stay alive and aligned for T, a mapping always is
+  explicit MappedDeque(std::span<const std::byte> bytes);
+
+  size_t size() const noexcept {
+    return elements_.size();
+  }
+
+  bool empty() const noexcept {
+    return elements_.empty();
+  }
+
+  const T& operator[](size_t index) const noexcept {
+    return elements_[index];
+  }
+
+  const T& at(size_t index) const {
+    if (index >= size()) {
+      throw std::out_of_range("Index out of range");
+    }
+    return elements_[index];
+  }
+
+  std::span<const T> elements() const noexcept {
+    return elements_;
+  }
+
+  const T* begin() const noexcept {
+    return elements_.data();
+  }
+
+  const T* end() const noexcept {
+    return elements_.data() + size();
+  }
+
+  // writes the header and the padding in front of count elements, the
+  // elements themselves follow in order
+  static void write_header(std::ostream& out, size_t count);
+
+ private:
+  struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t element_size;
+    uint64_t count;
+  };
+
+  // "dequsnap", read back in the wrong byte order it does not match
+  constexpr static uint64_t magic = 0x70616e7375716564;
+  constexpr static uint32_t version = 1;
+  constexpr static size_t elements_offset =
+      (sizeof(Header) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+  std::span<const T> elements_;
+};
+
+template <typename T>
+MappedDeque<T>::MappedDeque(std::span<const std::byte> bytes) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "snapshots hold trivially copyable elements only");
+  Header header;
+  if (bytes.size() < elements_offset) {
+    throw std::invalid_argument("truncated snapshot");
+  }
+  std::memcpy(&header, bytes.data(), sizeof(Header));
+  if (header.magic != magic || header.version != version ||
+      header.element_size != sizeof(T)) {
+    throw std::invalid_argument("not a snapshot of this deque type");
+  }
+  if ((bytes.size() - elements_offset) / sizeof(T) < header.count) {
+    throw std::invalid_argument("truncated snapshot");
+  }
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(T) != 0) {
+    throw std::invalid_argument("misaligned snapshot");
+  }
+  elements_ = {reinterpret_cast<const T*>(bytes.data() + elements_offset),
+               header.count};
+}
+
+template <typename T>
+void MappedDeque<T>::write_header(std::ostream& out, size_t count) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "snapshots hold trivially copyable elements only");
+  char bytes[elements_offset] = {};
+  Header header{magic, version, sizeof(T), count};
+  std::memcpy(bytes, &header, sizeof(Header));
+  out.write(bytes, elements_offset);
+}
+
+// filled only by deques built with CollectStats; chunk buffers come either
+// from the heap or from the spare pool, the chunk map either grows or has
+// its used slots moved back to the middle
+struct DequeStats {
+  size_t chunk_allocations = 0;
+  size_t chunk_reuses = 0;
+  size_t chunk_releases = 0;
+  size_t chunks_in_use = 0;
+  size_t spare_chunks = 0;
+  size_t map_reallocations = 0;
+  size_t map_recenters = 0;
+};
+
+template <typename T, size_t ChunkSize = default_chunk_size<T>,
+          bool CollectStats = false>
 class Deque {
   template <bool is_const>
   struct Iterator;
@@ -13,46 +139,83 @@ class Deque {
   using reverse_iterator = std::reverse_iterator<iterator>;
 
  private:
-  struct Chunk;
-  using DataType = std::vector<Chunk>;
-  using Coord = std::pair<int64_t, int64_t>;
-  static const size_t chunk_size = 32;
-  static const size_t init_size = 2;
+  struct ChunkPool;
+  struct FillIterator;
+  // a slot holds a chunk buffer iff the chunk has live elements
+  using MapType = std::vector<T*>;
+  static_assert(ChunkSize > 0, "chunk size must be positive");
+  constexpr static size_t chunk_size = ChunkSize;
+  constexpr static size_t init_size = 3;
+  constexpr static size_t max_spare_chunks = 8;
 
  public:
-  size_t size() const noexcept;
+  size_t size() const noexcept {
+    return end_ - begin_;
+  }
 
-  Deque()
-      : end_({0, -1}){};
+  Deque() = default;
 
   Deque(size_t size, const T& value);
 
-  auto& operator=(const Deque& deque);
+  Deque& operator=(const Deque& deque);
+
+  Deque(const Deque& deque);
 
-  Deque(const Deque& deque) = default;
+  // copies every chunk worth of elements at once
+  explicit Deque(const MappedDeque<T>& snapshot);
 
-  ~Deque() = default;
+  // steals the chunk map, elements are neither moved nor copied
+  Deque(Deque&& deque) noexcept
+      : map_(std::move(deque.map_)),
+        begin_(std::exchange(deque.begin_, 0)),
+        end_(std::exchange(deque.end_, 0)) {
+  }
+
+  Deque& operator=(Deque&& deque) noexcept;
+
+  ~Deque() {
+    clear();
+  }
 
   explicit Deque(size_t size)
       : Deque(size, T()) {
   }
 
-  void clear() noexcept {
-    data_.clear();
-    begin_ = Coord();
-    end_ = {0, -1};
+  void clear() noexcept;
+
+  // writes the layout read by MappedDeque one chunk at a time, T has to be
+  // trivially copyable
+  void write_snapshot(std::ostream& out) const;
+
+  iterator erase(iterator it) {
+    return erase(it, it + 1);
   }
 
-  void erase(iterator it);
+  iterator erase(iterator first, iterator last);
 
-  void insert(iterator it, const T& value);
+  iterator insert(iterator it, const T& value) {
+    return emplace(it, value);
+  }
 
-  T& operator[](size_t index) {
-    return *(begin() + index);
+  iterator insert(iterator it, T&& value) {
+    return emplace(it, std::move(value));
   }
 
-  const T& operator[](size_t index) const {
-    return *(begin() + index);
+  iterator insert(iterator it, size_t count, const T& value);
+
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  iterator insert(iterator it, InputIt first, InputIt last);
+
+  template <typename... Args>
+  iterator emplace(iterator it, Args&&... args);
+
+  T& operator[](size_t index) noexcept {
+    return *locate(begin_ + index);
+  }
+
+  const T& operator[](size_t index) const noexcept {
+    return *locate(begin_ + index);
   }
 
   T& at(size_t index) {
@@ -69,22 +232,55 @@ class Deque {
     return size() == 0;
   }
 
-  void push_back(const T& value);
+  // counters describe work done by this object, copies and moves never
+  // carry them over
+  DequeStats stats() const noexcept
+    requires CollectStats
+  {
+    DequeStats result = stats_;
+    result.chunks_in_use = map_.size() - std::ranges::count(map_, nullptr);
+    result.spare_chunks = pool_.spare();
+    return result;
+  }
+
+  void reset_stats() noexcept
+    requires CollectStats
+  {
+    stats_ = DequeStats();
+  }
+
+  void push_back(const T& value) {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value) {
+    emplace_back(std::move(value));
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args);
 
   void pop_back() noexcept;
 
-  void push_front(const T& value);
+  void push_front(const T& value) {
+    emplace_front(value);
+  }
+
+  void push_front(T&& value) {
+    emplace_front(std::move(value));
+  }
+
+  template <typename... Args>
+  T& emplace_front(Args&&... args);
 
   void pop_front() noexcept;
 
   iterator begin() noexcept {
-    return iterator{data_.begin() + begin_.first,
-                    (empty()) ? nullptr : data_[begin_.first].begin()};
+    return make_iterator<false>(begin_);
   }
 
   iterator end() noexcept {
-    return {data_.begin() + end_.first,
-            (empty()) ? nullptr : data_[end_.first].end()};
+    return make_iterator<false>(end_);
   }
 
   const_iterator begin() const noexcept {
@@ -96,40 +292,99 @@ class Deque {
   }
 
   const_iterator cbegin() const noexcept {
-    return const_iterator(data_.begin() + begin_.first,
-                          (empty()) ? nullptr : data_[begin_.first].begin());
+    return make_iterator<true>(begin_);
   }
 
   const_iterator cend() const noexcept {
-    return cbegin() + size();
+    return make_iterator<true>(end_);
   }
 
   reverse_iterator rbegin() noexcept {
-    return rend() - size() - 1;
+    return reverse_iterator(end());
   }
 
-  auto rend() noexcept;
+  reverse_iterator rend() noexcept {
+    return reverse_iterator(begin());
+  }
 
  private:
-  template <typename Type>
-  static inline Type ceil_divide(Type first, Type second) {
-    return (first - 1) / second + 1;
+  // chunk and offset of an absolute position, shifts and masks when the
+  // chunk size is a power of two
+  inline static size_t chunk_of(size_t position) noexcept {
+    if constexpr (std::has_single_bit(chunk_size)) {
+      return position >> std::countr_zero(chunk_size);
+    } else {
+      return position / chunk_size;
+    }
   }
 
-  void resize(size_t size);
+  inline static size_t offset_of(size_t position) noexcept {
+    if constexpr (std::has_single_bit(chunk_size)) {
+      return position & (chunk_size - 1);
+    } else {
+      return position % chunk_size;
+    }
+  }
 
-  void push_if_empty(const T& value) {
-    try {
-      init(1);
-      fill(value);
-      return;
-    } catch (...) {
-      clear();
-      throw;
+  inline T* locate(size_t position) const noexcept {
+    return map_[chunk_of(position)] + offset_of(position);
+  }
+
+  template <bool is_const>
+  Iterator<is_const> make_iterator(size_t position) const noexcept;
+
+  // makes room for count more elements at either end: moves the used slots
+  // to the middle of map_ in place if at most about half of it is in use,
+  // reallocates map_ twice as large otherwise
+  void make_room(size_t count);
+
+  // give the count raw positions right before begin_ or right after end_ a
+  // buffer, nothing is constructed there
+  void reserve_front(size_t count);
+
+  void reserve_back(size_t count);
+
+  // retires buffers of chunks in [from; to) that hold no live element
+  void release_range(size_t from, size_t to) noexcept;
+
+  // inserts count values taken from first at index, shifting the shorter
+  // side; every element on that side is moved exactly once
+  template <typename ForwardIt>
+  iterator insert_impl(size_t index, size_t count, ForwardIt first);
+
+  template <typename ForwardIt>
+  void shift_front(size_t index, size_t count, ForwardIt first);
+
+  template <typename ForwardIt>
+  void shift_back(size_t index, size_t count, ForwardIt first);
+
+  // move [from; to) to the positions starting at dest, or ending at dest for
+  // the backward one, one run within a chunk on both sides at a time, so the
+  // algorithms see plain pointers; dest must not lie inside the source in the
+  // direction of the walk
+  void move_range(size_t from, size_t to, size_t dest);
+
+  void move_range_backward(size_t from, size_t to, size_t dest);
+
+  // the same into raw positions, destroys what it built if a move throws
+  void uninitialized_move_range(size_t from, size_t to, size_t dest);
+
+  // buffers of emptied chunks go back to pool_ instead of the heap
+  inline void acquire_chunk(size_t chunk) {
+    if (map_[chunk] == nullptr) {
+      if constexpr (CollectStats) {
+        ++(pool_.spare() > 0 ? stats_.chunk_reuses : stats_.chunk_allocations);
+      }
+      map_[chunk] = pool_.acquire();
     }
   }
 
-  void init(size_t size);
+  inline void retire_chunk(size_t chunk) noexcept {
+    if constexpr (CollectStats) {
+      stats_.chunk_releases += map_[chunk] != nullptr;
+    }
+    pool_.release(std::exchange(map_[chunk], nullptr));
+  }
 
   inline void check_index(size_t index) const {
     if (index >= size()) {
@@ -137,318 +392,302 @@ class Deque {
     }
   }
 
-  void fill(const T& value);
+  struct NoStats {};
 
-  DataType data_;
-  Coord begin_;
-  Coord end_;  // [begin; end]
+  using Stats = std::conditional_t<CollectStats, DequeStats, NoStats>;
+
+  MapType map_;
+  size_t begin_ = 0;
+  size_t end_ = 0;  // [begin; end)
+  ChunkPool pool_;
+  [[no_unique_address]] Stats stats_;
 };
 
-template <typename T>
-size_t Deque<T>::size() const noexcept {
-  if (end_.first > begin_.first) {
-    return (end_.first - begin_.first - 1) * chunk_size + chunk_size -
-           begin_.second + end_.second + 1;
+template <typename T, size_t ChunkSize, bool CollectStats>
+Deque<T, ChunkSize, CollectStats>::Deque(size_t size, const T& value)
+    : Deque() {
+  for (size_t i = 0; i < size; ++i) {
+    push_back(value);
   }
-  return (end_.second - begin_.second + 1);
 }
 
-template <typename T>
-Deque<T>::Deque(size_t size, const T& value)
+template <typename T, size_t ChunkSize, bool CollectStats>
+Deque<T, ChunkSize, CollectStats>::Deque(const Deque& deque)
     : Deque() {
-  try {
-    init(size);
-    fill(value);
-  } catch (...) {
-    clear();
-    throw;
+  for (const auto& item : deque) {
+    push_back(item);
   }
 }
 
-template <typename T>
-auto& Deque<T>::operator=(const Deque& deque) {
-  DataType new_data(deque.data_);
-  std::swap(data_, new_data);
-  begin_ = deque.begin_;
-  end_ = deque.end_;
-  return *this;
-}
-
-template <typename T>
-void Deque<T>::push_back(const T& value) {
-  if (empty()) {
-    push_if_empty(value);
+template <typename T, size_t ChunkSize, bool CollectStats>
+Deque<T, ChunkSize, CollectStats>::Deque(const MappedDeque<T>& snapshot)
+    : Deque() {
+  if (snapshot.empty()) {
     return;
   }
-  if (end_ == Coord{data_.size() - 1, chunk_size - 1}) {
-    resize(2 * data_.size());
-  }
-  ++end_.second;
-  if (end_.second == static_cast<int64_t>(chunk_size)) {
-    ++end_.first;
-    end_.second = 0;
-    data_[end_.first].init(0, 0);
+  reserve_back(snapshot.size());
+  const T* from = snapshot.begin();
+  for (size_t left = snapshot.size(); left > 0;) {
+    size_t run = std::min(left, chunk_size - offset_of(end_));
+    std::memcpy(locate(end_), from, run * sizeof(T));
+    from += run;
+    left -= run;
+    end_ += run;
   }
-  data_[end_.first].push_back(value);
 }
 
-template <typename T>
-void Deque<T>::pop_back() noexcept {
-  data_[end_.first].pop_back();
-  if (end_.second == 0) {
-    end_.second = chunk_size - 1;
-    --end_.first;
-  } else {
-    --end_.second;
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::write_snapshot(
+    std::ostream& out) const {
+  MappedDeque<T>::write_header(out, size());
+  for (size_t position = begin_; position < end_;) {
+    size_t run = std::min(end_ - position, chunk_size - offset_of(position));
+    out.write(reinterpret_cast<const char*>(locate(position)),
+              run * sizeof(T));
+    position += run;
   }
 }
 
-template <typename T>
-void Deque<T>::push_front(const T& value) {
-  if (empty()) {
-    push_if_empty(value);
-    return;
+template <typename T, size_t ChunkSize, bool CollectStats>
+Deque<T, ChunkSize, CollectStats>& Deque<T, ChunkSize, CollectStats>::operator=(
+    const Deque& deque) {
+  if (this != &deque) {
+    Deque copy(deque);
+    std::swap(map_, copy.map_);
+    std::swap(begin_, copy.begin_);
+    std::swap(end_, copy.end_);
   }
-  if (begin_ == Coord{0, 0}) {
-    resize(2 * data_.size());
-  }
-  --begin_.second;
-  if (begin_.second == -1) {
-    --begin_.first;
-    begin_.second += chunk_size;
-    data_[begin_.first].init(chunk_size, chunk_size);
-  }
-  data_[begin_.first].push_front(value);
+  return *this;
 }
 
-template <typename T>
-void Deque<T>::pop_front() noexcept {
-  data_[begin_.first].pop_front();
-  if (begin_.second == chunk_size - 1) {
-    begin_.second = 0;
-    ++begin_.first;
-  } else {
-    ++begin_.second;
+template <typename T, size_t ChunkSize, bool CollectStats>
+Deque<T, ChunkSize, CollectStats>& Deque<T, ChunkSize, CollectStats>::operator=(
+    Deque&& deque) noexcept {
+  if (this != &deque) {
+    clear();
+    map_ = std::move(deque.map_);
+    begin_ = std::exchange(deque.begin_, 0);
+    end_ = std::exchange(deque.end_, 0);
   }
+  return *this;
 }
 
-template <typename T>
-auto Deque<T>::rend() noexcept {
-  return std::reverse_iterator(
-      iterator(data_.begin() + begin_.first,
-               (empty()) ? nullptr : data_[begin_.first].begin() - 1));
-}
-
-template <typename T>
-void Deque<T>::resize(size_t size) {
-  assert(size >= data_.size());
-  size = std::max(size, 2UL);
-  DataType new_data(size);
-  Coord old_begin = begin_;
-  Coord old_end = end_;
-  begin_.first = (new_data.size()) / 4;
-  end_.first = begin_.first + (old_end.first - old_begin.first);
-  if (end_.first == begin_.first) {
-    new_data[begin_.first].take(data_[old_begin.first]);
-  } else {
-    for (int64_t i = 0; i <= old_end.first - old_begin.first; ++i) {
-      new_data[end_.first - i].take(data_[old_end.first - i]);
-    }
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::clear() noexcept {
+  // a chunk at a time from the back, like pop_back but without the per
+  // element bookkeeping
+  while (!empty()) {
+    size_t run = std::min(size(), offset_of(end_ - 1) + 1);
+    end_ -= run;
+    std::destroy(locate(end_), locate(end_) + run);
+    retire_chunk(chunk_of(end_));
   }
-  std::ranges::swap(data_, new_data);
 }
 
-template <typename T>
-void Deque<T>::init(size_t size) {
-  // allocate memory and set coords
-  data_.resize(ceil_divide(std::max(size, init_size * chunk_size), chunk_size));
-  size_t remains = data_.size() * chunk_size - size;
-  size_t chunks_remains = remains / chunk_size;
-  remains %= chunk_size;
-  begin_ = {chunks_remains / 2, remains / 2};
-  if (size <= chunk_size - begin_.second) {
-    end_ = {begin_.first, begin_.second + size - 1};
-  } else {
-    end_.first = begin_.first +
-                 ceil_divide(size - (chunk_size - begin_.second), chunk_size);
-    end_.second = size - (end_.first - begin_.first - 1) * chunk_size -
-                  (chunk_size - begin_.second) - 1;
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename... Args>
+T& Deque<T, ChunkSize, CollectStats>::emplace_back(Args&&... args) {
+  if (chunk_of(end_ + 1) >= map_.size()) {
+    make_room(1);
   }
-  assert(size == this->size());
-}
-
-template <typename T>
-void Deque<T>::fill(const T& value) {
-  data_[begin_.first].init(begin_.second, (begin_.first == end_.first)
-                                              ? end_.second + 1
-                                              : chunk_size);
-  data_[begin_.first].fill(value);
-  if (begin_.first != end_.first) {
-    for (int i = begin_.first + 1; i < end_.first; ++i) {
-      data_[i].init(0, chunk_size);
-      data_[i].fill(value);
+  size_t chunk = chunk_of(end_);
+  bool fresh = map_[chunk] == nullptr;
+  acquire_chunk(chunk);
+  T* place = locate(end_);
+  try {
+    new (place) T(std::forward<Args>(args)...);
+  } catch (...) {
+    if (fresh) {
+      retire_chunk(chunk);
     }
-    data_[end_.first].init(0, end_.second + 1);
-    data_[end_.first].fill(value);
+    throw;
   }
+  ++end_;
+  return *place;
 }
 
-template <typename T>
-struct Deque<T>::Chunk {
-  Chunk()
-      : chunk_begin(0),
-        chunk_end(0),
-        data() {
-  }
-
-  Chunk(const Chunk& chunk)
-      : data(nullptr) {
-    init(chunk.chunk_begin, chunk.chunk_end);
-    std::copy(chunk.begin(), chunk.end(), begin());
-  }
-
-  void fill(const T& value);
-
-  void take(Chunk& chunk) noexcept;
-
-  auto& operator=(const Chunk& chunk);
-
-  void reserve() {
-    data = reinterpret_cast<T*>(new char[chunk_size * sizeof(T)]);
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::pop_back() noexcept {
+  --end_;
+  locate(end_)->~T();
+  if (begin_ == end_ || offset_of(end_) == 0) {
+    retire_chunk(chunk_of(end_));
   }
+}
 
-  void place(size_t index, const T& value) {
-    new (data + index) T(value);
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename... Args>
+T& Deque<T, ChunkSize, CollectStats>::emplace_front(Args&&... args) {
+  if (begin_ == 0) {
+    make_room(1);
   }
-
-  inline T* begin() const noexcept {
-    return data + chunk_begin;
+  size_t chunk = chunk_of(begin_ - 1);
+  bool fresh = map_[chunk] == nullptr;
+  acquire_chunk(chunk);
+  T* place = locate(begin_ - 1);
+  try {
+    new (place) T(std::forward<Args>(args)...);
+  } catch (...) {
+    if (fresh) {
+      retire_chunk(chunk);
+    }
+    throw;
   }
+  --begin_;
+  return *place;
+}
 
-  inline T* end() const noexcept {
-    return data + chunk_end;
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::pop_front() noexcept {
+  locate(begin_)->~T();
+  ++begin_;
+  if (begin_ == end_ || offset_of(begin_) == 0) {
+    retire_chunk(chunk_of(begin_ - 1));
   }
+}
 
-  void init(size_t begin, size_t end);
-
-  T& operator[](size_t i) noexcept {
-    return data[i];
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::make_room(size_t count) {
+  // leaves at least extra + 1 free slots on both sides
+  size_t extra = chunk_of(count) + 1;
+  if (empty()) {
+    // every slot is null here, only the position has to be reset
+    if (map_.size() < std::max(init_size, 2 * extra + 2)) {
+      map_.assign(std::max(init_size, 2 * extra + 2), nullptr);
+      if constexpr (CollectStats) {
+        ++stats_.map_reallocations;
+      }
+    }
+    begin_ = end_ = map_.size() / 2 * chunk_size;
+    return;
   }
-
-  T operator[](size_t i) const noexcept {
-    return data[i];
+  size_t first = chunk_of(begin_);
+  size_t used = chunk_of(end_) - first + 1;
+  size_t new_first = first;
+  if (2 * used + 2 * extra + 2 > map_.size()) {
+    MapType new_map(std::max(2 * map_.size(), 2 * used + 2 * extra + 2),
+                    nullptr);
+    new_first = (new_map.size() - used) / 2;
+    std::copy(map_.begin() + first, map_.begin() + first + used,
+              new_map.begin() + new_first);
+    std::ranges::swap(map_, new_map);
+    if constexpr (CollectStats) {
+      ++stats_.map_reallocations;
+    }
+  } else {
+    if constexpr (CollectStats) {
+      ++stats_.map_recenters;
+    }
+    new_first = (map_.size() - used) / 2;
+    // slots outside the used range are null, so rotating moves the used
+    // pointers and leaves nulls behind
+    if (new_first < first) {
+      std::rotate(map_.begin() + new_first, map_.begin() + first,
+                  map_.begin() + first + used);
+    } else {
+      std::rotate(map_.begin() + first, map_.begin() + first + used,
+                  map_.begin() + new_first + used);
+    }
   }
+  begin_ = begin_ - first * chunk_size + new_first * chunk_size;
+  end_ = end_ - first * chunk_size + new_first * chunk_size;
+}
 
-  inline bool empty() const noexcept {
-    return chunk_end <= chunk_begin;
-  }
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <bool is_const>
+typename Deque<T, ChunkSize, CollectStats>::template Iterator<is_const>
+Deque<T, ChunkSize, CollectStats>::make_iterator(
+    size_t position) const noexcept {
+  using ChunkPointer = typename Iterator<is_const>::ChunkPointer;
+  if (map_.empty()) {
+    return Iterator<is_const>(nullptr, nullptr);
+  }
+  auto chunk = const_cast<ChunkPointer>(map_.data() + chunk_of(position));
+  return Iterator<is_const>(
+      chunk, (*chunk == nullptr) ? nullptr : *chunk + offset_of(position));
+}
 
-  void push_back(const T& val) {
-    place(chunk_end, val);
-    ++chunk_end;
-  }
+template <typename T, size_t ChunkSize, bool CollectStats>
+struct Deque<T, ChunkSize, CollectStats>::ChunkPool {
+  ChunkPool() = default;
 
-  void pop_back() noexcept {
-    --chunk_end;
-    (data + chunk_end)->~T();
-  }
+  ChunkPool(const ChunkPool&) = delete;
 
-  void push_front(const T& val) {
-    place(chunk_begin - 1, val);
-    --chunk_begin;
-  }
+  ChunkPool& operator=(const ChunkPool&) = delete;
 
-  void pop_front() noexcept {
-    (data + chunk_begin)->~T();
-    ++chunk_begin;
+  ~ChunkPool() {
+    while (count_ > 0) {
+      deallocate(acquire());
+    }
   }
 
-  void clear() noexcept;
-
-  ~Chunk() {
-    clear();
+  static T* allocate() {
+    return static_cast<T*>(
+        ::operator new(buffer_size, std::align_val_t(buffer_alignment)));
   }
 
-  int64_t chunk_begin;
-  int64_t chunk_end;
-  T* data;
-};
-
-template <typename T>
-void Deque<T>::Chunk::fill(const T& value) {
-  for (auto i = begin(); i < end(); ++i) {
-    try {
-      new (i) T(value);
-    } catch (...) {
-      chunk_end = chunk_begin + i - begin();
-      throw;
+  static void deallocate(T* buffer) noexcept {
+    if (buffer != nullptr) {
+      ::operator delete(buffer, std::align_val_t(buffer_alignment));
     }
   }
-}
 
-template <typename T>
-void Deque<T>::Chunk::take(Deque<T>::Chunk& chunk) noexcept {
-  if (this == &chunk) {
-    return;
+  size_t spare() const noexcept {
+    return count_;
   }
-  clear();
-  chunk_begin = chunk.chunk_begin;
-  chunk_end = chunk.chunk_end;
-  data = chunk.data;
-  chunk.data = nullptr;
-}
 
-template <typename T>
-auto& Deque<T>::Chunk::operator=(const Deque<T>::Chunk& chunk) {
-  if (this == &chunk) {
-    return *this;
-  }
-  if (data != nullptr) {
-    clear();
+  T* acquire() {
+    if (head_ == nullptr) {
+      return allocate();
+    }
+    FreeNode* node = head_;
+    head_ = node->next;
+    --count_;
+    node->~FreeNode();
+    return reinterpret_cast<T*>(node);
   }
-  init(chunk.chunk_begin, chunk.chunk_end);
-  std::copy(chunk.begin(), chunk.end(), begin());
-  chunk_begin = chunk.chunk_begin;
-  chunk_end = chunk.chunk_end;
-  return *this;
-}
 
-template <typename T>
-void Deque<T>::Chunk::init(size_t begin, size_t end) {
-  if (data == nullptr) {
-    reserve();
+  void release(T* buffer) noexcept {
+    if (buffer == nullptr) {
+      return;
+    }
+    if (count_ == max_spare_chunks) {
+      deallocate(buffer);
+      return;
+    }
+    head_ = new (buffer) FreeNode{head_};
+    ++count_;
   }
-  chunk_begin = static_cast<int64_t>(begin);
-  chunk_end = static_cast<int64_t>(end);
-}
 
-template <typename T>
-void Deque<T>::Chunk::clear() noexcept {
-  while (!empty()) {
-    pop_back();
-  }
-  if (data != nullptr) {
-    delete[] reinterpret_cast<char*>(data);
-    data = nullptr;
-  }
-  chunk_begin = chunk_end = 0;
-}
+ private:
+  // retired buffers are linked through their own storage
+  struct FreeNode {
+    FreeNode* next;
+  };
+
+  constexpr static size_t buffer_size =
+      std::max(chunk_size * sizeof(T), sizeof(FreeNode));
+  constexpr static size_t buffer_alignment =
+      std::max(alignof(T), alignof(FreeNode));
+
+  FreeNode* head_ = nullptr;
+  size_t count_ = 0;
+};
 
-template <typename T>
+// an iterator is a map slot and a pointer into its chunk, a position in a
+// slot without a buffer (only ever end()) holds a null pointer
+template <typename T, size_t ChunkSize, bool CollectStats>
 template <bool is_const>
-struct Deque<T>::Iterator {
+struct Deque<T, ChunkSize, CollectStats>::Iterator {
  public:
-  using difference_type = uint32_t;
+  using difference_type = std::ptrdiff_t;
   using value_type = std::conditional_t<is_const, const T, T>;
   using pointer = value_type*;
   using reference = value_type&;
   using iterator_category = std::random_access_iterator_tag;
+  using ChunkPointer = std::conditional_t<is_const, T* const*, T**>;
 
-  Iterator(
-      std::conditional_t<is_const, const typename DataType ::const_iterator&,
-                         const typename DataType::iterator&>
-          first,
-      pointer second)
+  Iterator(ChunkPointer first, pointer second)
       : first_iter(first),
         second_iter(second) {
   }
@@ -461,7 +700,11 @@ struct Deque<T>::Iterator {
 
   Iterator& operator--();
 
-  Iterator operator++(int);
+  Iterator operator++(int) {
+    Iterator copy = *this;
+    operator++();
+    return copy;
+  }
 
   Iterator operator--(int) {
     Iterator copy = *this;
@@ -469,13 +712,13 @@ struct Deque<T>::Iterator {
     return copy;
   }
 
-  Iterator& operator+=(int add) {
+  Iterator& operator+=(difference_type add) {
     return (*this) = (*this) + add;
   }
 
-  Iterator operator+(int add) const;
+  Iterator operator+(difference_type add) const;
 
-  Iterator operator-(int add) const {
+  Iterator operator-(difference_type add) const {
     return operator+(-add);
   }
 
@@ -501,125 +744,542 @@ struct Deque<T>::Iterator {
     return x < y || x == y;
   }
 
-  auto& operator-=(int add) {
+  auto& operator-=(difference_type add) {
     return operator+=(-add);
   }
 
-  difference_type operator-(const Iterator& it) noexcept;
+  difference_type operator-(const Iterator& it) const noexcept {
+    return (first_iter - it.first_iter) *
+               static_cast<difference_type>(chunk_size) +
+           offset() - it.offset();
+  }
 
-  reference operator*() noexcept {
+  reference operator*() const noexcept {
     return *second_iter;
   }
 
-  pointer operator->() noexcept {
+  pointer operator->() const noexcept {
     return second_iter;
   }
 
-  std::conditional_t<is_const, typename DataType::const_iterator,
-                     typename DataType::iterator>
-      first_iter;
+  ChunkPointer first_iter;
   pointer second_iter;
+
+ private:
+  inline difference_type offset() const noexcept {
+    return (second_iter == nullptr) ? 0 : second_iter - *first_iter;
+  }
 };
 
-template <typename T>
+template <typename T, size_t ChunkSize, bool CollectStats>
 template <bool is_const>
-typename Deque<T>::template Iterator<is_const>&
-Deque<T>::Iterator<is_const>::operator--() {
-  if (second_iter == nullptr) {
-    return *this;
-  }
-  if (second_iter == first_iter->data) {
+typename Deque<T, ChunkSize, CollectStats>::template Iterator<is_const>&
+Deque<T, ChunkSize, CollectStats>::Iterator<is_const>::operator--() {
+  if (second_iter == nullptr || second_iter == *first_iter) {
     --first_iter;
-    second_iter = (first_iter->end());
+    second_iter = *first_iter + chunk_size;
   }
   --second_iter;
   return *this;
 }
 
-template <typename T>
+template <typename T, size_t ChunkSize, bool CollectStats>
 template <bool is_const>
-typename Deque<T>::template Iterator<is_const>&
-Deque<T>::Iterator<is_const>::operator++() {
-  if (second_iter == nullptr) {
-    return *this;
-  }
+typename Deque<T, ChunkSize, CollectStats>::template Iterator<is_const>&
+Deque<T, ChunkSize, CollectStats>::Iterator<is_const>::operator++() {
   ++second_iter;
-  if (second_iter == first_iter->data + chunk_size) {
+  if (second_iter == *first_iter + chunk_size) {
     ++first_iter;
-    second_iter = first_iter->data;
+    second_iter = *first_iter;
   }
   return *this;
 }
 
-template <typename T>
+template <typename T, size_t ChunkSize, bool CollectStats>
 template <bool is_const>
-typename Deque<T>::template Iterator<is_const>
-Deque<T>::Iterator<is_const>::operator++(int) {
-  auto copy = *this;
-  if (second_iter != nullptr) {
-    operator++();
+typename Deque<T, ChunkSize, CollectStats>::template Iterator<is_const>
+Deque<T, ChunkSize, CollectStats>::Iterator<is_const>::operator+(
+    difference_type add) const {
+  if (add == 0 || first_iter == nullptr) {
+    return *this;
   }
-  return copy;
+  difference_type diff = offset() + add;
+  difference_type chunks = diff / static_cast<difference_type>(chunk_size);
+  diff %= static_cast<difference_type>(chunk_size);
+  if (diff < 0) {
+    --chunks;
+    diff += chunk_size;
+  }
+  ChunkPointer new_first = first_iter + chunks;
+  return Iterator<is_const>{
+      new_first, (*new_first == nullptr) ? nullptr : *new_first + diff};
 }
 
-template <typename T>
-template <bool is_const>
-typename Deque<T>::template Iterator<is_const>
-Deque<T>::Iterator<is_const>::operator+(int add) const {
-  if (add == 0 || second_iter == nullptr) {
-    return *this;
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::reserve_front(size_t count) {
+  if (begin_ < count) {
+    make_room(count);
   }
-  auto new_first = first_iter + add / static_cast<int64_t>(chunk_size);
-  add %= static_cast<int64_t>(chunk_size);
-  int64_t diff = second_iter - first_iter->data + add;
-  if (add > 0 && diff >= static_cast<int64_t>(chunk_size)) {
-    ++new_first;
-    diff -= chunk_size;
+  try {
+    for (size_t i = chunk_of(begin_ - count); i <= chunk_of(begin_ - 1); ++i) {
+      acquire_chunk(i);
+    }
+  } catch (...) {
+    release_range(begin_ - count, begin_);
+    throw;
   }
-  if (add < 0 && diff < 0) {
-    --new_first;
-    diff += chunk_size;
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::reserve_back(size_t count) {
+  if (chunk_of(end_ + count) >= map_.size()) {
+    make_room(count);
+  }
+  try {
+    for (size_t i = chunk_of(end_); i <= chunk_of(end_ + count - 1); ++i) {
+      acquire_chunk(i);
+    }
+  } catch (...) {
+    release_range(end_, end_ + count);
+    throw;
   }
-  return Iterator<is_const>{new_first, new_first->data + diff};
 }
 
-template <typename T>
-template <bool is_const>
-typename Deque<T>::template Iterator<is_const>::difference_type
-Deque<T>::Iterator<is_const>::operator-(
-    const Deque::Iterator<is_const>& it) noexcept {
-  if (first_iter == it.first_iter) {
-    return second_iter - it.second_iter;
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::release_range(size_t from,
+                                                      size_t to) noexcept {
+  if (from == to) {
+    return;
+  }
+  for (size_t i = chunk_of(from); i <= chunk_of(to - 1); ++i) {
+    // a chunk is live iff it intersects [begin_; end_)
+    if (empty() || i < chunk_of(begin_) || i > chunk_of(end_ - 1)) {
+      retire_chunk(i);
+    }
   }
-  return (first_iter - it.first_iter - 1) * chunk_size +
-         (second_iter - first_iter->data) +
-         (chunk_size - (it.second_iter - it.first_iter->data));
 }
 
-template <typename T>
-void Deque<T>::erase(Deque::iterator it) {
-  if (it == begin()) {
-    pop_front();
-  } else if (it == --end()) {
-    pop_back();
+template <typename T, size_t ChunkSize, bool CollectStats>
+typename Deque<T, ChunkSize, CollectStats>::iterator
+Deque<T, ChunkSize, CollectStats>::erase(
+    iterator first, iterator last) {
+  size_t index = first - begin();
+  size_t count = last - first;
+  if (count == 0) {
+    return first;
+  }
+  if (index < size() - index - count) {
+    std::move_backward(begin(), first, last);
+    for (size_t i = 0; i < count; ++i) {
+      pop_front();
+    }
   } else {
-    while (it + 1 != end()) {
-      std::ranges::swap(*it, *(it + 1));
-      ++it;
+    std::move(last, end(), first);
+    for (size_t i = 0; i < count; ++i) {
+      pop_back();
     }
-    pop_back();
   }
+  return begin() + index;
 }
 
-template <typename T>
-void Deque<T>::insert(Deque::iterator it, const T& value) {
-  if (it == end()) {
-    push_back(value);
+// the new element is built before anything moves, so arguments referring
+// to elements of the deque stay valid while it is constructed
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename... Args>
+typename Deque<T, ChunkSize, CollectStats>::iterator
+Deque<T, ChunkSize, CollectStats>::emplace(
+    Deque::iterator it, Args&&... args) {
+  size_t index = it - begin();
+  if (index == size()) {
+    emplace_back(std::forward<Args>(args)...);
+    return end() - 1;
+  }
+  if (index == 0) {
+    emplace_front(std::forward<Args>(args)...);
+    return begin();
+  }
+  T value(std::forward<Args>(args)...);
+  return insert_impl(index, 1, std::make_move_iterator(std::addressof(value)));
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+typename Deque<T, ChunkSize, CollectStats>::iterator
+Deque<T, ChunkSize, CollectStats>::insert(
+    iterator it, size_t count, const T& value) {
+  size_t index = it - begin();
+  T copy(value);
+  return insert_impl(index, count, FillIterator{&copy});
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename InputIt, typename>
+typename Deque<T, ChunkSize, CollectStats>::iterator
+Deque<T, ChunkSize, CollectStats>::insert(
+    iterator it, InputIt first, InputIt last) {
+  size_t index = it - begin();
+  using Category = typename std::iterator_traits<InputIt>::iterator_category;
+  if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+    return insert_impl(index, std::distance(first, last), first);
   } else {
-    auto diff = it - begin();
-    push_front(value);
-    for (auto i = begin(); i != begin() + diff; ++i) {
-      std::ranges::swap(*i, *(i + 1));
+    Deque buffer;
+    for (; first != last; ++first) {
+      buffer.emplace_back(*first);
     }
+    return insert_impl(index, buffer.size(),
+                       std::make_move_iterator(buffer.begin()));
+  }
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename ForwardIt>
+typename Deque<T, ChunkSize, CollectStats>::iterator
+Deque<T, ChunkSize, CollectStats>::insert_impl(
+    size_t index, size_t count, ForwardIt first) {
+  if (count == 0) {
+    return begin() + index;
+  }
+  if (index < size() - index) {
+    shift_front(index, count, first);
+  } else {
+    shift_back(index, count, first);
+  }
+  return begin() + index;
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::move_range(size_t from, size_t to,
+                                                   size_t dest) {
+  while (from < to) {
+    size_t run = std::min({to - from, chunk_size - offset_of(from),
+                           chunk_size - offset_of(dest)});
+    std::move(locate(from), locate(from) + run, locate(dest));
+    from += run;
+    dest += run;
+  }
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::move_range_backward(size_t from,
+                                                            size_t to,
+                                                            size_t dest) {
+  while (from < to) {
+    size_t run = std::min(
+        {to - from, offset_of(to - 1) + 1, offset_of(dest - 1) + 1});
+    to -= run;
+    dest -= run;
+    std::move_backward(locate(to), locate(to) + run, locate(dest) + run);
+  }
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+void Deque<T, ChunkSize, CollectStats>::uninitialized_move_range(size_t from,
+                                                                 size_t to,
+                                                                 size_t dest) {
+  size_t built = dest;
+  try {
+    while (from < to) {
+      size_t run = std::min({to - from, chunk_size - offset_of(from),
+                             chunk_size - offset_of(built)});
+      std::uninitialized_move(locate(from), locate(from) + run,
+                              locate(built));
+      from += run;
+      built += run;
+    }
+  } catch (...) {
+    std::destroy(make_iterator<false>(dest), make_iterator<false>(built));
+    throw;
+  }
+}
+
+// elements before index move count positions towards the front: the first
+// ones land in raw slots, the rest are move assigned, and values fill the
+// gap partly by construction and partly by assignment
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename ForwardIt>
+void Deque<T, ChunkSize, CollectStats>::shift_front(size_t index, size_t count,
+                                      ForwardIt first) {
+  reserve_front(count);
+  size_t old_position = begin_;
+  size_t pos = begin_ + index;
+  try {
+    if (count <= index) {
+      uninitialized_move_range(old_position, old_position + count,
+                               old_position - count);
+      begin_ -= count;
+      move_range(old_position + count, pos, old_position);
+      std::copy_n(first, count, make_iterator<false>(pos - count));
+    } else {
+      uninitialized_move_range(old_position, pos, old_position - count);
+      iterator new_begin = make_iterator<false>(old_position - count);
+      iterator moved = make_iterator<false>(pos - count);
+      try {
+        std::uninitialized_copy_n(first, count - index, moved);
+      } catch (...) {
+        std::destroy(new_begin, moved);
+        throw;
+      }
+      begin_ -= count;
+      std::copy_n(std::next(first, count - index), index,
+                  make_iterator<false>(old_position));
+    }
+  } catch (...) {
+    release_range(old_position - count, old_position);
+    throw;
+  }
+}
+
+template <typename T, size_t ChunkSize, bool CollectStats>
+template <typename ForwardIt>
+void Deque<T, ChunkSize, CollectStats>::shift_back(size_t index, size_t count,
+                                     ForwardIt first) {
+  reserve_back(count);
+  size_t old_position = end_;
+  size_t tail = size() - index;
+  size_t pos = begin_ + index;
+  try {
+    if (count <= tail) {
+      uninitialized_move_range(old_position - count, old_position,
+                               old_position);
+      end_ += count;
+      move_range_backward(pos, old_position - count, old_position);
+      std::copy_n(first, count, make_iterator<false>(pos));
+    } else {
+      iterator old_end = make_iterator<false>(old_position);
+      iterator copied = std::uninitialized_copy_n(std::next(first, tail),
+                                                  count - tail, old_end);
+      try {
+        uninitialized_move_range(pos, old_position,
+                                 old_position + count - tail);
+      } catch (...) {
+        std::destroy(old_end, copied);
+        throw;
+      }
+      end_ += count;
+      std::copy_n(first, tail, make_iterator<false>(pos));
+    }
+  } catch (...) {
+    release_range(old_position, old_position + count);
+    throw;
+  }
+}
+
+// a forward iterator that yields the same value forever
+template <typename T, size_t ChunkSize, bool CollectStats>
+struct Deque<T, ChunkSize, CollectStats>::FillIterator {
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = const T*;
+  using reference = const T&;
+  using iterator_category = std::forward_iterator_tag;
+
+  reference operator*() const noexcept {
+    return *value;
+  }
+
+  pointer operator->() const noexcept {
+    return value;
+  }
+
+  FillIterator& operator++() noexcept {
+    return *this;
+  }
+
+  FillIterator operator++(int) noexcept {
+    return *this;
+  }
+
+  bool operator==(const FillIterator&) const noexcept {
+    return false;
+  }
+
+  const T* value;
+};
+
+// a chunked queue for exactly one producer and one consumer thread: the
+// producer fills the tail chunk and publishes every element with a release
+// store of tail, the consumer drains the head chunk and publishes which
+// chunk it is in; chunks behind the consumer are reused by the producer, so
+// a steady stream allocates nothing
+template <typename T, size_t ChunkSize = default_chunk_size<T>>
+class SpscQueue {
+ public:
+  SpscQueue();
+
+  SpscQueue(const SpscQueue&) = delete;
+
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  ~SpscQueue();
+
+  // producer side
+
+  template <typename... Args>
+  void emplace(Args&&... args);
+
+  void push(const T& value) {
+    emplace(value);
+  }
+
+  void push(T&& value) {
+    emplace(std::move(value));
+  }
+
+  // consumer side
+
+  // null when the queue is empty
+  T* front() noexcept;
+
+  // the queue must not be empty
+  void pop() noexcept;
+
+  bool try_pop(T& value);
+
+  // either side, exact only while the other one is idle
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  size_t size() const noexcept {
+    size_t head = consumer_.head.load(std::memory_order_acquire);
+    return producer_.tail.load(std::memory_order_acquire) - head;
+  }
+
+ private:
+  struct Chunk;
+  static_assert(ChunkSize > 0, "chunk size must be positive");
+  constexpr static size_t chunk_size = ChunkSize;
+  constexpr static size_t cache_line_size = 64;
+
+  Chunk* acquire_chunk();
+
+  bool readable() noexcept;
+
+  T* consumer_slot() noexcept;
+
+  // written by the producer only
+  struct alignas(cache_line_size) ProducerState {
+    std::atomic<size_t> tail = 0;
+    Chunk* chunk;
+    size_t offset = 0;
+    // the oldest chunk, first in line for reuse
+    Chunk* spare;
+  };
+
+  // written by the consumer only
+  struct alignas(cache_line_size) ConsumerState {
+    std::atomic<size_t> head = 0;
+    std::atomic<Chunk*> chunk;
+    size_t offset = 0;
+    // last tail seen, the shared line is only read once it is caught up
+    size_t cached_tail = 0;
+  };
+
+  ProducerState producer_;
+  ConsumerState consumer_;
+};
+
+template <typename T, size_t ChunkSize>
+struct SpscQueue<T, ChunkSize>::Chunk {
+  T* slot(size_t offset) noexcept {
+    return std::launder(reinterpret_cast<T*>(storage) + offset);
+  }
+
+  std::atomic<Chunk*> next = nullptr;
+  alignas(T) std::byte storage[chunk_size * sizeof(T)];
+};
+
+template <typename T, size_t ChunkSize>
+SpscQueue<T, ChunkSize>::SpscQueue() {
+  Chunk* chunk = new Chunk;
+  producer_.chunk = producer_.spare = chunk;
+  consumer_.chunk.store(chunk, std::memory_order_relaxed);
+}
+
+template <typename T, size_t ChunkSize>
+SpscQueue<T, ChunkSize>::~SpscQueue() {
+  while (readable()) {
+    pop();
+  }
+  // the chain runs from the oldest spare through the tail chunk
+  for (Chunk* chunk = producer_.spare; chunk != nullptr;) {
+    delete std::exchange(chunk, chunk->next.load(std::memory_order_relaxed));
+  }
+}
+
+template <typename T, size_t ChunkSize>
+template <typename... Args>
+void SpscQueue<T, ChunkSize>::emplace(Args&&... args) {
+  if (producer_.offset == chunk_size) {
+    Chunk* chunk = acquire_chunk();
+    producer_.chunk->next.store(chunk, std::memory_order_release);
+    producer_.chunk = chunk;
+    producer_.offset = 0;
+  }
+  new (producer_.chunk->slot(producer_.offset)) T(std::forward<Args>(args)...);
+  ++producer_.offset;
+  size_t tail = producer_.tail.load(std::memory_order_relaxed);
+  producer_.tail.store(tail + 1, std::memory_order_release);
+}
+
+// chunks before the one the consumer is in have been fully drained
+template <typename T, size_t ChunkSize>
+typename SpscQueue<T, ChunkSize>::Chunk*
+SpscQueue<T, ChunkSize>::acquire_chunk() {
+  Chunk* chunk = producer_.spare;
+  if (chunk == consumer_.chunk.load(std::memory_order_acquire)) {
+    return new Chunk;
+  }
+  producer_.spare = chunk->next.load(std::memory_order_relaxed);
+  chunk->next.store(nullptr, std::memory_order_relaxed);
+  return chunk;
+}
+
+template <typename T, size_t ChunkSize>
+bool SpscQueue<T, ChunkSize>::readable() noexcept {
+  size_t head = consumer_.head.load(std::memory_order_relaxed);
+  if (head != consumer_.cached_tail) {
+    return true;
+  }
+  consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+  return head != consumer_.cached_tail;
+}
+
+// moves on to the next chunk lazily, it is only linked once an element in it
+// has been published
+template <typename T, size_t ChunkSize>
+T* SpscQueue<T, ChunkSize>::consumer_slot() noexcept {
+  Chunk* chunk = consumer_.chunk.load(std::memory_order_relaxed);
+  if (consumer_.offset == chunk_size) {
+    chunk = chunk->next.load(std::memory_order_acquire);
+    consumer_.chunk.store(chunk, std::memory_order_release);
+    consumer_.offset = 0;
+  }
+  return chunk->slot(consumer_.offset);
+}
+
+template <typename T, size_t ChunkSize>
+T* SpscQueue<T, ChunkSize>::front() noexcept {
+  return readable() ? consumer_slot() : nullptr;
+}
+
+template <typename T, size_t ChunkSize>
+void SpscQueue<T, ChunkSize>::pop() noexcept {
+  [[maybe_unused]] bool has_value = readable();
+  assert(has_value);
+  std::destroy_at(consumer_slot());
+  ++consumer_.offset;
+  size_t head = consumer_.head.load(std::memory_order_relaxed);
+  consumer_.head.store(head + 1, std::memory_order_release);
+}
+
+template <typename T, size_t ChunkSize>
+bool SpscQueue<T, ChunkSize>::try_pop(T& value) {
+  T* slot = front();
+  if (slot == nullptr) {
+    return false;
   }
+  value = std::move(*slot);
+  pop();
+  return true;
 }
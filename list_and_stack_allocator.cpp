@@ -1,10 +1,44 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// the inline buffer is all the arena has, allocation fails once it is full
+struct FixedArena {};
+
+// extra heap blocks are chained once the inline buffer is exhausted
+struct GrowingArena {};
+
+// filled only by arenas built with CollectStats; bytes in use are the
+// requests not handed back through deallocate yet, high_water is the
+// largest used() seen after an allocation
+struct StackStorageStats {
+  size_t allocations = 0;
+  size_t failed_allocations = 0;
+  size_t bytes_requested = 0;
+  size_t bytes_in_use = 0;
+  size_t high_water = 0;
+};
 
-template <size_t N>
+template <size_t N, typename GrowthPolicy = FixedArena,
+          bool CollectStats = false>
 class StackStorage {
+  struct Block;
+
  public:
+  // a position in the arena, release_to drops everything allocated after it
+  struct Marker {
+    Block* block;
+    size_t size;
+  };
+
   StackStorage(const StackStorage&) = delete;
   auto& operator=(const StackStorage&) = delete;
 
@@ -13,25 +47,112 @@ class StackStorage {
 
   ~StackStorage() {
     std::cout << "";  // dealing with clang bug
+    while (blocks_ != nullptr) {
+      Block* next = blocks_->next;
+      ::operator delete(blocks_);
+      blocks_ = next;
+    }
   }
 
-  inline size_t used() const noexcept {
-    return N - size_;
+  // walks the chained blocks, so it is linear in their number
+  size_t used() const noexcept;
+
+  inline Marker mark() const noexcept {
+    return {current_, size_};
+  }
+
+  // chained blocks are kept and reused by the following allocations, so
+  // rewinding is O(1) and a steady per-request pattern stops allocating
+  inline void release_to(Marker marker) noexcept {
+    current_ = marker.block;
+    size_ = marker.size;
+    if constexpr (CollectStats) {
+      // whatever was allocated after the marker is gone as well
+      stats_.bytes_in_use = std::min(stats_.bytes_in_use, used());
+    }
+  }
+
+  inline void reset() noexcept {
+    release_to({nullptr, N});
   }
 
   template <typename T>
   T* create_with_alignment(size_t count);
 
+  // the arena never reuses freed bytes, this only keeps the counters right
+  inline void release([[maybe_unused]] size_t bytes) noexcept {
+    if constexpr (CollectStats) {
+      stats_.bytes_in_use -= std::min(stats_.bytes_in_use, bytes);
+    }
+  }
+
+  StackStorageStats stats() const noexcept
+    requires CollectStats
+  {
+    return stats_;
+  }
+
+  void reset_stats() noexcept
+    requires CollectStats
+  {
+    stats_ = StackStorageStats();
+  }
+
  private:
+  struct alignas(std::max_align_t) Block {
+    Block* next;
+    size_t capacity;
+
+    char* data() noexcept {
+      return reinterpret_cast<char*>(this + 1);
+    }
+  };
+
+  static constexpr bool is_growing =
+      std::is_same_v<GrowthPolicy, GrowingArena>;
+
+  char* top() noexcept {
+    if (current_ == nullptr) {
+      return storage_ + (N - size_);
+    }
+    return current_->data() + (current_->capacity - size_);
+  }
+
+  template <typename T>
+  T* bump(size_t size) noexcept;
+
+  void advance(size_t min_capacity);
+
+  template <typename T>
+  T* record(T* ptr, size_t size) noexcept;
+
+  struct NoStats {};
+
   char storage_[N];
+  // free bytes left in the current block, the inline buffer when it is null
   size_t size_;
+  Block* current_ = nullptr;
+  Block* blocks_ = nullptr;
+  [[no_unique_address]] std::conditional_t<CollectStats, StackStorageStats,
+                                           NoStats> stats_;
 };
 
-template <size_t N>
+template <size_t N, typename GrowthPolicy, bool CollectStats>
+size_t StackStorage<N, GrowthPolicy, CollectStats>::used() const noexcept {
+  if (current_ == nullptr) {
+    return N - size_;
+  }
+  size_t used = N;
+  for (Block* block = blocks_; block != current_; block = block->next) {
+    used += block->capacity;
+  }
+  return used + current_->capacity - size_;
+}
+
+template <size_t N, typename GrowthPolicy, bool CollectStats>
 template <typename T>
-T* StackStorage<N>::create_with_alignment(size_t count) {
-  void* st = storage_ + used();
-  size_t size = sizeof(T) * count;
+T* StackStorage<N, GrowthPolicy, CollectStats>::bump(size_t size) noexcept {
+  void* st = top();
   if (std::align(alignof(T), size, st, size_)) {
     T* ptr = reinterpret_cast<T*>(st);
     size_ -= size;
@@ -40,29 +161,79 @@ T* StackStorage<N>::create_with_alignment(size_t count) {
   return nullptr;
 }
 
-template <typename T, size_t N>
+template <size_t N, typename GrowthPolicy, bool CollectStats>
+void StackStorage<N, GrowthPolicy, CollectStats>::advance(size_t min_capacity) {
+  Block* next = current_ == nullptr ? blocks_ : current_->next;
+  if (next == nullptr || next->capacity < min_capacity) {
+    size_t capacity = std::max(
+        {min_capacity, N, current_ == nullptr ? 0 : 2 * current_->capacity});
+    Block* block =
+        new (::operator new(sizeof(Block) + capacity)) Block{next, capacity};
+    (current_ == nullptr ? blocks_ : current_->next) = block;
+    next = block;
+  }
+  current_ = next;
+  size_ = next->capacity;
+}
+
+template <size_t N, typename GrowthPolicy, bool CollectStats>
+template <typename T>
+T* StackStorage<N, GrowthPolicy, CollectStats>::create_with_alignment(
+    size_t count) {
+  size_t size = sizeof(T) * count;
+  if (T* ptr = bump<T>(size)) {
+    return record(ptr, size);
+  }
+  if constexpr (is_growing) {
+    advance(size + alignof(T));
+    return record(bump<T>(size), size);
+  }
+  return record<T>(nullptr, size);
+}
+
+template <size_t N, typename GrowthPolicy, bool CollectStats>
+template <typename T>
+T* StackStorage<N, GrowthPolicy, CollectStats>::record(
+    T* ptr, [[maybe_unused]] size_t size) noexcept {
+  if constexpr (CollectStats) {
+    ++(ptr == nullptr ? stats_.failed_allocations : stats_.allocations);
+    stats_.bytes_requested += size;
+    if (ptr != nullptr) {
+      stats_.bytes_in_use += size;
+      stats_.high_water = std::max(stats_.high_water, used());
+    }
+  }
+  return ptr;
+}
+
+template <typename T, size_t N, typename GrowthPolicy = FixedArena,
+          bool CollectStats = false>
 class StackAllocator {
+  using Storage = StackStorage<N, GrowthPolicy, CollectStats>;
+
  public:
   using value_type = T;
   using pointer = T*;
 
-  explicit StackAllocator(StackStorage<N>& stack_storage) {
+  explicit StackAllocator(Storage& stack_storage) {
     set_storage(&stack_storage);
   }
 
   StackAllocator()
-      : StackAllocator(StackStorage<N>()) {
+      : StackAllocator(Storage()) {
   }
 
   template <class U>
-  StackAllocator(const StackAllocator<U, N>& allocator)
+  StackAllocator(
+      const StackAllocator<U, N, GrowthPolicy, CollectStats>& allocator)
       : storage_(allocator.get_storage()) {
   }
   pointer allocate(size_t size) {
     return storage_->template create_with_alignment<value_type>(size);
   }
 
-  void deallocate(pointer, size_t) {
+  void deallocate(pointer, size_t size) noexcept {
+    storage_->release(sizeof(T) * size);
   }
 
   bool operator==(const StackAllocator& stack_allocator) const {
@@ -80,7 +251,7 @@ class StackAllocator {
 
   template <typename U>
   struct rebind {
-    using other = StackAllocator<U, N>;
+    using other = StackAllocator<U, N, GrowthPolicy, CollectStats>;
   };
 
   auto& get_storage() const {
@@ -88,11 +259,362 @@ class StackAllocator {
   }
 
  private:
-  void set_storage(StackStorage<N>* stack_storage) noexcept {
+  void set_storage(Storage* stack_storage) noexcept {
     storage_ = stack_storage;
   }
 
-  StackStorage<N>* storage_;
+  Storage* storage_;
+};
+
+// fixed-size blocks carved from slabs, freed blocks go to an intrusive free
+// list of their size class and are handed out again before the slab grows
+template <size_t SlabSize = 64 * 1024>
+class PoolStorage {
+ public:
+  static constexpr size_t granularity = alignof(std::max_align_t);
+  static constexpr size_t max_block_size = 16 * granularity;
+
+  PoolStorage(const PoolStorage&) = delete;
+  auto& operator=(const PoolStorage&) = delete;
+
+  PoolStorage() = default;
+
+  ~PoolStorage();
+
+  // larger or over-aligned requests bypass the pool
+  void* allocate(size_t size, size_t alignment);
+
+  void deallocate(void* ptr, size_t size, size_t alignment) noexcept;
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct alignas(std::max_align_t) Slab {
+    Slab* next;
+  };
+
+  static_assert(SlabSize >= max_block_size, "slab must fit the largest block");
+  static constexpr size_t class_count = max_block_size / granularity;
+
+  static bool is_pooled(size_t size, size_t alignment) noexcept {
+    return size <= max_block_size && alignment <= granularity;
+  }
+
+  static size_t size_class(size_t size) noexcept {
+    return size == 0 ? 0 : (size - 1) / granularity;
+  }
+
+  void* carve(size_t block_size);
+
+  std::array<FreeBlock*, class_count> free_{};
+  Slab* slabs_ = nullptr;
+  char* slab_top_ = nullptr;
+  size_t slab_left_ = 0;
+};
+
+template <size_t SlabSize>
+PoolStorage<SlabSize>::~PoolStorage() {
+  while (slabs_ != nullptr) {
+    Slab* next = slabs_->next;
+    ::operator delete(slabs_);
+    slabs_ = next;
+  }
+}
+
+template <size_t SlabSize>
+void* PoolStorage<SlabSize>::carve(size_t block_size) {
+  if (slab_left_ < block_size) {
+    // the tail of the previous slab is too short for this class and is lost
+    slabs_ = new (::operator new(sizeof(Slab) + SlabSize)) Slab{slabs_};
+    slab_top_ = reinterpret_cast<char*>(slabs_ + 1);
+    slab_left_ = SlabSize;
+  }
+  void* ptr = slab_top_;
+  slab_top_ += block_size;
+  slab_left_ -= block_size;
+  return ptr;
+}
+
+template <size_t SlabSize>
+void* PoolStorage<SlabSize>::allocate(size_t size, size_t alignment) {
+  if (!is_pooled(size, alignment)) {
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+  size_t index = size_class(size);
+  if (FreeBlock* block = free_[index]) {
+    free_[index] = block->next;
+    return block;
+  }
+  return carve((index + 1) * granularity);
+}
+
+template <size_t SlabSize>
+void PoolStorage<SlabSize>::deallocate(void* ptr, size_t size,
+                                       size_t alignment) noexcept {
+  if (!is_pooled(size, alignment)) {
+    ::operator delete(ptr, std::align_val_t(alignment));
+    return;
+  }
+  size_t index = size_class(size);
+  free_[index] = new (ptr) FreeBlock{free_[index]};
+}
+
+template <typename T, size_t SlabSize = 64 * 1024>
+class PoolAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+
+  explicit PoolAllocator(PoolStorage<SlabSize>& pool_storage) noexcept
+      : storage_(&pool_storage) {
+  }
+
+  template <class U>
+  PoolAllocator(const PoolAllocator<U, SlabSize>& allocator) noexcept
+      : storage_(allocator.get_storage()) {
+  }
+
+  pointer allocate(size_t size) {
+    return static_cast<pointer>(
+        storage_->allocate(sizeof(T) * size, alignof(T)));
+  }
+
+  void deallocate(pointer ptr, size_t size) noexcept {
+    storage_->deallocate(ptr, sizeof(T) * size, alignof(T));
+  }
+
+  bool operator==(const PoolAllocator& pool_allocator) const {
+    return storage_ == pool_allocator.storage_;
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = PoolAllocator<U, SlabSize>;
+  };
+
+  auto get_storage() const noexcept {
+    return storage_;
+  }
+
+ private:
+  PoolStorage<SlabSize>* storage_;
+};
+
+// a PoolStorage shared between threads: every thread allocates from and frees
+// to its own magazine of blocks per size class, and only refills or flushes
+// half a magazine at a time under the depot lock
+template <size_t SlabSize = 64 * 1024, size_t MagazineSize = 32>
+class CachedPoolStorage {
+  using Pool = PoolStorage<SlabSize>;
+
+ public:
+  CachedPoolStorage(const CachedPoolStorage&) = delete;
+  auto& operator=(const CachedPoolStorage&) = delete;
+
+  CachedPoolStorage()
+      : depot_(std::make_shared<Depot>()),
+        id_(next_id_.fetch_add(1, std::memory_order_relaxed)) {
+  }
+
+  void* allocate(size_t size, size_t alignment);
+
+  void deallocate(void* ptr, size_t size, size_t alignment) noexcept;
+
+ private:
+  struct Depot {
+    std::mutex mutex;
+    Pool pool;
+  };
+
+  struct Magazine {
+    size_t count = 0;
+    std::array<void*, MagazineSize> blocks;
+  };
+
+  struct ThreadCache;
+  struct ThreadCaches;
+
+  static_assert(MagazineSize >= 2, "a magazine is refilled by halves");
+  static constexpr size_t class_count =
+      Pool::max_block_size / Pool::granularity;
+
+  static bool is_pooled(size_t size, size_t alignment) noexcept {
+    return size <= Pool::max_block_size && alignment <= Pool::granularity;
+  }
+
+  static size_t size_class(size_t size) noexcept {
+    return size == 0 ? 0 : (size - 1) / Pool::granularity;
+  }
+
+  static size_t block_size(size_t index) noexcept {
+    return (index + 1) * Pool::granularity;
+  }
+
+  static void refill(Depot& depot, Magazine& magazine, size_t index);
+
+  static void flush(Depot& depot, Magazine& magazine, size_t index,
+                    size_t keep) noexcept;
+
+  ThreadCache& local_cache();
+
+  inline static std::atomic<size_t> next_id_ = 0;
+
+  std::shared_ptr<Depot> depot_;
+  // never reused, so a thread cannot mistake a dead storage for a new one
+  size_t id_;
+};
+
+template <size_t SlabSize, size_t MagazineSize>
+struct CachedPoolStorage<SlabSize, MagazineSize>::ThreadCache {
+  ThreadCache(size_t id, const std::shared_ptr<Depot>& depot)
+      : id(id),
+        owner(depot) {
+  }
+
+  ThreadCache(const ThreadCache&) = delete;
+  auto& operator=(const ThreadCache&) = delete;
+
+  // blocks of a storage that is already gone are simply forgotten
+  ~ThreadCache() {
+    if (auto depot = owner.lock()) {
+      for (size_t i = 0; i < class_count; ++i) {
+        flush(*depot, magazines[i], i, 0);
+      }
+    }
+  }
+
+  size_t id;
+  std::weak_ptr<Depot> owner;
+  std::array<Magazine, class_count> magazines;
+};
+
+template <size_t SlabSize, size_t MagazineSize>
+struct CachedPoolStorage<SlabSize, MagazineSize>::ThreadCaches {
+  ThreadCache* last = nullptr;
+  std::vector<std::unique_ptr<ThreadCache>> caches;
+};
+
+template <size_t SlabSize, size_t MagazineSize>
+auto CachedPoolStorage<SlabSize, MagazineSize>::local_cache() -> ThreadCache& {
+  thread_local ThreadCaches local;
+  if (local.last != nullptr && local.last->id == id_) {
+    return *local.last;
+  }
+  std::erase_if(local.caches, [](const auto& cache) {
+    return cache->owner.expired();
+  });
+  auto it = std::ranges::find_if(
+      local.caches, [this](const auto& cache) { return cache->id == id_; });
+  if (it == local.caches.end()) {
+    local.caches.push_back(std::make_unique<ThreadCache>(id_, depot_));
+    it = std::prev(local.caches.end());
+  }
+  local.last = it->get();
+  return *local.last;
+}
+
+template <size_t SlabSize, size_t MagazineSize>
+void CachedPoolStorage<SlabSize, MagazineSize>::refill(Depot& depot,
+                                                       Magazine& magazine,
+                                                       size_t index) {
+  std::lock_guard lock(depot.mutex);
+  while (magazine.count < MagazineSize / 2) {
+    magazine.blocks[magazine.count] =
+        depot.pool.allocate(block_size(index), Pool::granularity);
+    ++magazine.count;
+  }
+}
+
+template <size_t SlabSize, size_t MagazineSize>
+void CachedPoolStorage<SlabSize, MagazineSize>::flush(Depot& depot,
+                                                      Magazine& magazine,
+                                                      size_t index,
+                                                      size_t keep) noexcept {
+  if (magazine.count <= keep) {
+    return;
+  }
+  std::lock_guard lock(depot.mutex);
+  while (magazine.count > keep) {
+    --magazine.count;
+    depot.pool.deallocate(magazine.blocks[magazine.count], block_size(index),
+                          Pool::granularity);
+  }
+}
+
+template <size_t SlabSize, size_t MagazineSize>
+void* CachedPoolStorage<SlabSize, MagazineSize>::allocate(size_t size,
+                                                          size_t alignment) {
+  if (!is_pooled(size, alignment)) {
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+  size_t index = size_class(size);
+  Magazine& magazine = local_cache().magazines[index];
+  if (magazine.count == 0) {
+    refill(*depot_, magazine, index);
+  }
+  --magazine.count;
+  return magazine.blocks[magazine.count];
+}
+
+template <size_t SlabSize, size_t MagazineSize>
+void CachedPoolStorage<SlabSize, MagazineSize>::deallocate(
+    void* ptr, size_t size, size_t alignment) noexcept {
+  if (!is_pooled(size, alignment)) {
+    ::operator delete(ptr, std::align_val_t(alignment));
+    return;
+  }
+  size_t index = size_class(size);
+  Magazine& magazine = local_cache().magazines[index];
+  if (magazine.count == MagazineSize) {
+    flush(*depot_, magazine, index, MagazineSize / 2);
+  }
+  magazine.blocks[magazine.count] = ptr;
+  ++magazine.count;
+}
+
+template <typename T, size_t SlabSize = 64 * 1024, size_t MagazineSize = 32>
+class CachedPoolAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using Storage = CachedPoolStorage<SlabSize, MagazineSize>;
+
+  explicit CachedPoolAllocator(Storage& pool_storage) noexcept
+      : storage_(&pool_storage) {
+  }
+
+  template <class U>
+  CachedPoolAllocator(
+      const CachedPoolAllocator<U, SlabSize, MagazineSize>& allocator) noexcept
+      : storage_(allocator.get_storage()) {
+  }
+
+  pointer allocate(size_t size) {
+    return static_cast<pointer>(
+        storage_->allocate(sizeof(T) * size, alignof(T)));
+  }
+
+  void deallocate(pointer ptr, size_t size) noexcept {
+    storage_->deallocate(ptr, sizeof(T) * size, alignof(T));
+  }
+
+  bool operator==(const CachedPoolAllocator& pool_allocator) const {
+    return storage_ == pool_allocator.storage_;
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = CachedPoolAllocator<U, SlabSize, MagazineSize>;
+  };
+
+  auto get_storage() const noexcept {
+    return storage_;
+  }
+
+ private:
+  Storage* storage_;
 };
 
 template <typename T, typename Allocator = std::allocator<T>>
@@ -191,6 +713,12 @@ class List {
 
   List(const List& list);
 
+  List(List&& list) noexcept
+      : alloc_(std::move(list.alloc_)),
+        size_(0) {
+    steal(list);
+  }
+
   ~List() {
     clear();
   }
@@ -199,6 +727,8 @@ class List {
 
   List& operator=(const List& list);
 
+  List& operator=(List&& list);
+
   bool is_empty() const {
     return size_ == 0;
   }
@@ -215,6 +745,8 @@ class List {
   using NodeTraits = std::allocator_traits<NodeAlloc>;
   using AllocTraits = std::allocator_traits<Allocator>;
 
+  void steal(List& list) noexcept;
+
   [[no_unique_address]] NodeAlloc alloc_;
   BaseNode fake_node_;
   size_t size_;
@@ -254,6 +786,39 @@ List<T, Allocator>& List<T, Allocator>::operator=(const List& list) {
   return *this;
 }
 
+template <typename T, typename Allocator>
+List<T, Allocator>& List<T, Allocator>::operator=(List&& list) {
+  if (this == &list) {
+    return *this;
+  }
+  clear();
+  if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+    alloc_ = std::move(list.alloc_);
+  } else if (!(alloc_ == list.alloc_)) {
+    for (auto&& item : list) {
+      push_back(std::move(item));
+    }
+    list.clear();
+    return *this;
+  }
+  steal(list);
+  return *this;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::steal(List& list) noexcept {
+  if (list.is_empty()) {
+    return;
+  }
+  fake_node_.next = list.fake_node_.next;
+  fake_node_.prev = list.fake_node_.prev;
+  fake_node_.next->prev = &fake_node_;
+  fake_node_.prev->next = &fake_node_;
+  size_ = list.size_;
+  list.fake_node_.next = list.fake_node_.prev = &list.fake_node_;
+  list.size_ = 0;
+}
+
 template <typename T, typename Allocator>
 bool List<T, Allocator>::operator==(const List& list) const {
   if (list.size() != size()) {
@@ -407,11 +972,11 @@ struct List<T, Allocator>::Iterator {
   }
 
   pointer operator->() {
-    return node->get_value();
+    return &static_cast<Node*>(node)->value;
   }
 
   reference operator*() {
-    return *static_cast<Node*>(node)->get_value();
+    return static_cast<Node*>(node)->value;
   }
 
   bool operator==(const Iterator& iterator) const {
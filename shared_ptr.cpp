@@ -1,5 +1,96 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <iostream>
-template <typename T>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// reference counts of pointers that never leave their thread
+struct SingleThreaded {
+  using Counter = uint;
+
+  static void increment(Counter& counter) noexcept {
+    ++counter;
+  }
+
+  // true once the count drops to zero
+  static bool decrement(Counter& counter) noexcept {
+    return --counter == 0;
+  }
+
+  static bool increment_if_nonzero(Counter& counter) noexcept {
+    if (counter == 0) {
+      return false;
+    }
+    ++counter;
+    return true;
+  }
+
+  static uint load(const Counter& counter) noexcept {
+    return counter;
+  }
+};
+
+// reference counts of pointers shared between threads
+struct MultiThreaded {
+  using Counter = std::atomic<uint>;
+
+  // a new reference is always copied from a live one, nothing to order
+  static void increment(Counter& counter) noexcept {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // release publishes this owner's writes, acquire lets the last owner see
+  // all of them before it destroys the object
+  static bool decrement(Counter& counter) noexcept {
+    return counter.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+
+  // a count that reached zero stays there, so an expired object is never
+  // brought back by a concurrent lock
+  static bool increment_if_nonzero(Counter& counter) noexcept {
+    uint count = counter.load(std::memory_order_relaxed);
+    do {
+      if (count == 0) {
+        return false;
+      }
+    } while (!counter.compare_exchange_weak(count, count + 1,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed));
+    return true;
+  }
+
+  static uint load(const Counter& counter) noexcept {
+    return counter.load(std::memory_order_relaxed);
+  }
+};
+
+// reference counts shared between threads, where the last owner only
+// retires the object and Reclaimer destroys it later in a batch
+struct DeferredRelease : MultiThreaded {
+  // sequentially consistent with the epoch and the pins of Reclaimer, a
+  // guard that still sees a count pinned no later than its retirement
+  static bool decrement(Counter& counter) noexcept {
+    return counter.fetch_sub(1) == 1;
+  }
+
+  static uint load(const Counter& counter) noexcept {
+    return counter.load();
+  }
+
+  template <typename Block>
+  static void retire(Block* block);
+};
+
+template <typename T, typename Policy = SingleThreaded>
 class EnableSharedFromThis;
 
 template <typename Alloc>
@@ -20,12 +111,48 @@ auto recast_allocator(U from) {
   return NewAlloc(from);
 }
 
+template <typename Policy>
 struct BaseControlBlock {
-  uint shared_count;
-  uint weak_count;
+  typename Policy::Counter shared_count;
+  // the weak pointers plus one reference held by all shared owners together,
+  // so the block outlives the object while it is being destroyed
+  typename Policy::Counter weak_count;
   BaseControlBlock(uint shared_count, uint weak_count)
       : shared_count(shared_count),
-        weak_count(weak_count) {
+        weak_count(weak_count + 1) {
+  }
+
+  void add_shared() noexcept {
+    Policy::increment(shared_count);
+  }
+
+  bool try_add_shared() noexcept {
+    return Policy::increment_if_nonzero(shared_count);
+  }
+
+  void add_weak() noexcept {
+    Policy::increment(weak_count);
+  }
+
+  void release_shared() {
+    if (Policy::decrement(shared_count)) {
+      if constexpr (requires { Policy::retire(this); }) {
+        Policy::retire(this);
+      } else {
+        use_deleter();
+        release_weak();
+      }
+    }
+  }
+
+  void release_weak() {
+    if (Policy::decrement(weak_count)) {
+      dispose();
+    }
+  }
+
+  uint use_count() const noexcept {
+    return Policy::load(shared_count);
   }
 
   virtual ~BaseControlBlock() = default;
@@ -34,15 +161,16 @@ struct BaseControlBlock {
   virtual void* get() = 0;
 };
 
-template <typename Real, typename Deleter, typename Allocator>
-struct ControlBlockRegular : BaseControlBlock {
+template <typename Real, typename Deleter, typename Allocator,
+          typename Policy>
+struct ControlBlockRegular : BaseControlBlock<Policy> {
   Real* ptr;
   [[no_unique_address]] Deleter deleter;
   [[no_unique_address]] Allocator allocator;
 
   ControlBlockRegular(Real* ptr, Deleter deleter, Allocator allocator,
                       uint shared_count = 1, uint weak_count = 0)
-      : BaseControlBlock(shared_count, weak_count),
+      : BaseControlBlock<Policy>(shared_count, weak_count),
         ptr(ptr),
         deleter(deleter),
         allocator(allocator) {
@@ -59,8 +187,8 @@ struct ControlBlockRegular : BaseControlBlock {
   }
 };
 
-template <typename T, typename Allocator>
-struct ControlBlockFromMake : BaseControlBlock {
+template <typename T, typename Allocator, typename Policy>
+struct ControlBlockFromMake : BaseControlBlock<Policy> {
   T object;
   [[no_unique_address]] Allocator allocator;
 
@@ -71,7 +199,7 @@ struct ControlBlockFromMake : BaseControlBlock {
   template <typename... Args>
   ControlBlockFromMake(Allocator allocator, uint shared_count, uint weak_count,
                        Args&&... args)
-      : BaseControlBlock(shared_count, weak_count),
+      : BaseControlBlock<Policy>(shared_count, weak_count),
         object(std::forward<Args>(args)...),
         allocator(allocator) {
   }
@@ -83,14 +211,57 @@ struct ControlBlockFromMake : BaseControlBlock {
   }
 };
 
-template <typename T>
+// one of the blocks of a batch that share a single allocation, each object
+// still has its own counts and the allocation goes with the last block
+template <typename T, typename Policy>
+struct ControlBlockFromBatch : BaseControlBlock<Policy> {
+  struct Batch {
+    typename Policy::Counter blocks;
+  };
+
+  T object;
+  Batch* batch;
+
+  template <typename... Args>
+  ControlBlockFromBatch(Batch* batch, const Args&... args)
+      : BaseControlBlock<Policy>(1, 0),
+        object(args...),
+        batch(batch) {
+  }
+
+  // the batch header, then the blocks right after it
+  static constexpr size_t alignment() {
+    return std::max(alignof(Batch), alignof(ControlBlockFromBatch));
+  }
+
+  static constexpr size_t blocks_offset() {
+    return (sizeof(Batch) + alignof(ControlBlockFromBatch) - 1) /
+           alignof(ControlBlockFromBatch) * alignof(ControlBlockFromBatch);
+  }
+
+  void use_deleter() override {
+    std::destroy_at(&object);
+  }
+
+  void dispose() override;
+
+  void* get() override {
+    return &object;
+  }
+};
+
+template <typename T, typename Policy = SingleThreaded>
 class SharedPtr {
-  template <typename U>
+  template <typename U, typename P>
   friend class WeakPtr;
-  template <typename U>
+  template <typename U, typename P>
   friend class SharedPtr;
 
-  BaseControlBlock* control_block_;
+  using ControlBlock = BaseControlBlock<Policy>;
+
+  // cached next to the block, so dereferencing never reaches the block
+  T* ptr_;
+  ControlBlock* control_block_;
 
  public:
   template <typename U = T, typename Deleter = std::default_delete<T>,
@@ -98,19 +269,29 @@ class SharedPtr {
   SharedPtr(U* ptr = nullptr, Deleter deleter = Deleter(),
             Allocator allocator = Allocator());
 
-  SharedPtr(BaseControlBlock* control_block);
+  SharedPtr(ControlBlock* control_block);
 
   SharedPtr& operator=(const SharedPtr& shared_ptr);
 
   template <typename U>
-  SharedPtr(const SharedPtr<U>& shared_ptr);
+  SharedPtr(const SharedPtr<U, Policy>& shared_ptr);
+
+  template <typename U>
+  SharedPtr(SharedPtr<U, Policy>&& shared_ptr) noexcept;
 
+  SharedPtr(const SharedPtr& shared_ptr);
+
+  // shares ownership with shared_ptr but points to ptr, usually a member of
+  // the object it owns
   template <typename U>
-  SharedPtr(SharedPtr<U>&& shared_ptr);
+  SharedPtr(const SharedPtr<U, Policy>& shared_ptr, T* ptr);
 
-  SharedPtr(const SharedPtr<T>& shared_ptr);
+  template <typename U>
+  SharedPtr(SharedPtr<U, Policy>&& shared_ptr, T* ptr) noexcept;
 
-  T* get() const;
+  T* get() const noexcept {
+    return ptr_;
+  }
 
   T& operator*() const {
     return *get();
@@ -122,7 +303,8 @@ class SharedPtr {
 
   size_t use_count() const;
 
-  void swap(SharedPtr& shared_ptr) {
+  void swap(SharedPtr& shared_ptr) noexcept {
+    std::swap(ptr_, shared_ptr.ptr_);
     std::swap(control_block_, shared_ptr.control_block_);
   }
 
@@ -136,66 +318,87 @@ class SharedPtr {
              Allocator allocator = Allocator());
 
   template <typename Allocator, typename... Args>
-  static SharedPtr<T> construct(const Allocator& allocator, Args&&... args);
+  static SharedPtr construct(const Allocator& allocator, Args&&... args);
+
+  template <typename... Args>
+  static std::vector<SharedPtr> construct_batch(size_t count,
+                                                const Args&... args);
 
-  SharedPtr(SharedPtr&& ptr);
+  SharedPtr(SharedPtr&& ptr) noexcept
+      : ptr_(std::exchange(ptr.ptr_, nullptr)),
+        control_block_(std::exchange(ptr.control_block_, nullptr)) {
+  }
 
-  SharedPtr& operator=(SharedPtr&& ptr);
+  SharedPtr& operator=(SharedPtr&& ptr) noexcept;
 
  private:
+  struct AdoptTag {};
+
+  // takes over a shared reference that the caller has already added
+  SharedPtr(ControlBlock* control_block, T* ptr, AdoptTag) noexcept
+      : ptr_(ptr),
+        control_block_(control_block) {
+  }
+
   void clear();
 
   template <typename U = T, typename Allocator, typename Deleter>
-  ControlBlockRegular<U, Deleter, Allocator>* create_by_ptr(U* ptr,
-                                                            Allocator allocator,
-                                                            Deleter deleter);
+  ControlBlockRegular<U, Deleter, Allocator, Policy>* create_by_ptr(
+      U* ptr, Allocator allocator, Deleter deleter);
 };
 
-template <typename T>
+template <typename T, typename Policy = SingleThreaded>
 class WeakPtr {
-  BaseControlBlock* control_block_;
+  T* ptr_;
+  BaseControlBlock<Policy>* control_block_;
 
-  template <typename U>
+  template <typename U, typename P>
   friend class WeakPtr;
 
  public:
   T* get() const noexcept {
-    if (control_block_ == nullptr) {
-      return nullptr;
-    }
-    return reinterpret_cast<T*>(control_block_->get());
+    return ptr_;
   }
 
   inline bool expired() const noexcept {
-    return control_block_ == nullptr || control_block_->shared_count == 0;
+    return control_block_ == nullptr || control_block_->use_count() == 0;
   }
 
   WeakPtr()
-      : WeakPtr(SharedPtr<T>()) {
+      : WeakPtr(SharedPtr<T, Policy>()) {
   }
 
   template <typename U = T>
-  WeakPtr(SharedPtr<U> other = SharedPtr<U>());
+  WeakPtr(SharedPtr<U, Policy> other = SharedPtr<U, Policy>());
 
   template <typename U = T>
-  WeakPtr& operator=(SharedPtr<U> other);
+  WeakPtr& operator=(SharedPtr<U, Policy> other);
 
   template <typename U = T>
-  WeakPtr(WeakPtr<U> other);
+  WeakPtr(WeakPtr<U, Policy> other);
 
   WeakPtr(const WeakPtr& other);
 
   WeakPtr& operator=(const WeakPtr& other);
 
-  WeakPtr(WeakPtr&& ptr);
+  WeakPtr(WeakPtr&& ptr) noexcept
+      : ptr_(std::exchange(ptr.ptr_, nullptr)),
+        control_block_(std::exchange(ptr.control_block_, nullptr)) {
+  }
 
   WeakPtr& operator=(WeakPtr&& other);
 
-  SharedPtr<T> lock() const {
-    return SharedPtr<T>(control_block_);
+  // an expired pointer yields an empty SharedPtr, never a revived object
+  SharedPtr<T, Policy> lock() const noexcept {
+    if (control_block_ == nullptr || !control_block_->try_add_shared()) {
+      return SharedPtr<T, Policy>();
+    }
+    using Shared = SharedPtr<T, Policy>;
+    return Shared(control_block_, ptr_, typename Shared::AdoptTag());
   }
 
-  void swap(WeakPtr& ptr) {
+  void swap(WeakPtr& ptr) noexcept {
+    std::swap(ptr_, ptr.ptr_);
     std::swap(control_block_, ptr.control_block_);
   }
 
@@ -203,272 +406,916 @@ class WeakPtr {
 
   ~WeakPtr();
 };
-template <typename T>
-WeakPtr<T>& WeakPtr<T>::operator=(const WeakPtr& other) {
+template <typename T, typename Policy>
+WeakPtr<T, Policy>& WeakPtr<T, Policy>::operator=(const WeakPtr& other) {
   WeakPtr copy = other;
   swap(copy);
   return *this;
 }
 
-template <typename T>
+template <typename T, typename Policy>
 class EnableSharedFromThis {
-  WeakPtr<T> weak_ptr_;
-  template <class U>
+  WeakPtr<T, Policy> weak_ptr_;
+  template <class U, class P>
   friend class SharedPtr;
 
-  template <class U>
+  template <class U, class P>
   friend class WeakPtr;
 
  public:
-  SharedPtr<T> shared_from_this() const {
+  SharedPtr<T, Policy> shared_from_this() const {
     return weak_ptr_.lock();
   }
 
-  WeakPtr<T> weak_from_this() const {
+  WeakPtr<T, Policy> weak_from_this() const {
     return weak_ptr_;
   }
 };
 
-template <typename Real, typename Deleter, typename Allocator>
-void ControlBlockRegular<Real, Deleter, Allocator>::dispose() {
+template <typename Real, typename Deleter, typename Allocator,
+          typename Policy>
+void ControlBlockRegular<Real, Deleter, Allocator, Policy>::dispose() {
   auto new_allocator =
-      recast_allocator<ControlBlockRegular<Real, Deleter, Allocator>>(
+      recast_allocator<ControlBlockRegular<Real, Deleter, Allocator, Policy>>(
           allocator);
   deallocate(new_allocator, this, 1);
 }
 
-template <typename T, typename Allocator>
-void ControlBlockFromMake<T, Allocator>::dispose() {
+template <typename T, typename Allocator, typename Policy>
+void ControlBlockFromMake<T, Allocator, Policy>::dispose() {
   auto new_allocator =
-      recast_allocator<ControlBlockFromMake<T, Allocator>>(allocator);
+      recast_allocator<ControlBlockFromMake<T, Allocator, Policy>>(allocator);
   deallocate(new_allocator, this, 1);
 }
 
-template <typename T>
-SharedPtr<T>::SharedPtr(BaseControlBlock* control_block)
-    : control_block_(control_block) {
+template <typename T, typename Policy>
+void ControlBlockFromBatch<T, Policy>::dispose() {
+  if (Policy::decrement(batch->blocks)) {
+    std::destroy_at(batch);
+    ::operator delete(batch, std::align_val_t(alignment()));
+  }
+}
+
+template <typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(ControlBlock* control_block)
+    : ptr_(nullptr),
+      control_block_(control_block) {
   if (control_block == nullptr) {
     throw "bad control block";
   }
-  ++control_block_->shared_count;
+  ptr_ = reinterpret_cast<T*>(control_block_->get());
+  control_block_->add_shared();
 }
-template <typename T>
-SharedPtr<T>& SharedPtr<T>::operator=(const SharedPtr& shared_ptr) {
+template <typename T, typename Policy>
+SharedPtr<T, Policy>& SharedPtr<T, Policy>::operator=(
+    const SharedPtr& shared_ptr) {
   SharedPtr copy = shared_ptr;
   swap(copy);
   return *this;
 }
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-SharedPtr<T>::SharedPtr(const SharedPtr<U>& shared_ptr)
-    : control_block_(shared_ptr.control_block_) {
+SharedPtr<T, Policy>::SharedPtr(const SharedPtr<U, Policy>& shared_ptr)
+    : SharedPtr(shared_ptr, shared_ptr.ptr_) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
-  ++control_block_->shared_count;
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-SharedPtr<T>::SharedPtr(SharedPtr<U>&& shared_ptr)
-    : control_block_(shared_ptr.control_block_) {
+SharedPtr<T, Policy>::SharedPtr(SharedPtr<U, Policy>&& shared_ptr) noexcept
+    : SharedPtr(std::move(shared_ptr), shared_ptr.ptr_) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
-  ++control_block_->shared_count;
-  shared_ptr.reset();
 }
 
-template <typename T>
-SharedPtr<T>::SharedPtr(const SharedPtr<T>& shared_ptr)
-    : control_block_(shared_ptr.control_block_) {
+template <typename T, typename Policy>
+SharedPtr<T, Policy>::SharedPtr(const SharedPtr& shared_ptr)
+    : ptr_(shared_ptr.ptr_),
+      control_block_(shared_ptr.control_block_) {
   if (control_block_ != nullptr) {
-    ++control_block_->shared_count;
+    control_block_->add_shared();
   }
 }
 
-template <typename T>
-T* SharedPtr<T>::get() const {
-  if (control_block_ == nullptr) {
-    return nullptr;
+template <typename T, typename Policy>
+template <typename U>
+SharedPtr<T, Policy>::SharedPtr(const SharedPtr<U, Policy>& shared_ptr, T* ptr)
+    : ptr_(ptr),
+      control_block_(shared_ptr.control_block_) {
+  if (control_block_ != nullptr) {
+    control_block_->add_shared();
   }
-  return reinterpret_cast<T*>(control_block_->get());
 }
 
-template <typename T>
-size_t SharedPtr<T>::use_count() const {
+template <typename T, typename Policy>
+template <typename U>
+SharedPtr<T, Policy>::SharedPtr(SharedPtr<U, Policy>&& shared_ptr,
+                                T* ptr) noexcept
+    : ptr_(ptr),
+      control_block_(std::exchange(shared_ptr.control_block_, nullptr)) {
+  shared_ptr.ptr_ = nullptr;
+}
+
+template <typename T, typename Policy>
+size_t SharedPtr<T, Policy>::use_count() const {
   if (control_block_ == nullptr) {
     return 0;
   }
-  return control_block_->shared_count;
+  return control_block_->use_count();
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <typename U, typename Deleter, typename Allocator>
-auto SharedPtr<T>::reset(U* new_ptr, Deleter deleter, Allocator allocator) {
+auto SharedPtr<T, Policy>::reset(U* new_ptr, Deleter deleter,
+                                 Allocator allocator) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
   if (new_ptr != nullptr) {
     SharedPtr copy(new_ptr, deleter, allocator);
     swap(copy);
   } else {
     clear();
+    ptr_ = nullptr;
     control_block_ = nullptr;
   }
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <typename Allocator, typename... Args>
-SharedPtr<T> SharedPtr<T>::construct(const Allocator& allocator,
-                                     Args&&... args) {
-  using NewAlloc = typename std::allocator_traits<
-      Allocator>::template rebind_alloc<ControlBlockFromMake<T, Allocator>>;
+SharedPtr<T, Policy> SharedPtr<T, Policy>::construct(const Allocator& allocator,
+                                                     Args&&... args) {
+  using Block = ControlBlockFromMake<T, Allocator, Policy>;
+  using NewAlloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Block>;
   NewAlloc new_alloc = allocator;
 
-  ControlBlockFromMake<T, Allocator>* block =
-      std::allocator_traits<NewAlloc>::allocate(new_alloc, 1);
+  Block* block = std::allocator_traits<NewAlloc>::allocate(new_alloc, 1);
   std::allocator_traits<NewAlloc>::construct(new_alloc, block, allocator, 0, 0,
                                              std::forward<Args>(args)...);
-  auto result = SharedPtr<T>(static_cast<BaseControlBlock*>(block));
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  auto result = SharedPtr(static_cast<ControlBlock*>(block), &block->object,
+                          AdoptTag());
+  block->add_shared();
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     result.get()->weak_ptr_ = result;
   }
   return result;
 }
 
-template <typename T>
-SharedPtr<T>::SharedPtr(SharedPtr&& ptr)
-    : control_block_(ptr.control_block_) {
-  ++control_block_->shared_count;
-  ptr.reset();
+template <typename T, typename Policy>
+template <typename... Args>
+std::vector<SharedPtr<T, Policy>> SharedPtr<T, Policy>::construct_batch(
+    size_t count, const Args&... args) {
+  using Block = ControlBlockFromBatch<T, Policy>;
+  using Batch = typename Block::Batch;
+  std::vector<SharedPtr> result;
+  if (count == 0) {
+    return result;
+  }
+  if (count > std::numeric_limits<uint>::max()) {
+    throw std::length_error("SharedPtr batch is too large");
+  }
+  result.reserve(count);
+
+  void* memory = ::operator new(Block::blocks_offset() + count * sizeof(Block),
+                                std::align_val_t(Block::alignment()));
+  Batch* batch = ::new (memory) Batch{static_cast<uint>(count)};
+  auto* blocks = reinterpret_cast<Block*>(static_cast<std::byte*>(memory) +
+                                          Block::blocks_offset());
+  size_t built = 0;
+  try {
+    for (; built < count; ++built) {
+      std::construct_at(blocks + built, batch, args...);
+    }
+  } catch (...) {
+    // the blocks built so far release the batch as if their owners had gone
+    if (built == 0) {
+      std::destroy_at(batch);
+      ::operator delete(memory, std::align_val_t(Block::alignment()));
+      throw;
+    }
+    batch->blocks = static_cast<uint>(built);
+    for (size_t i = 0; i < built; ++i) {
+      blocks[i].use_deleter();
+      blocks[i].dispose();
+    }
+    throw;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    result.push_back(SharedPtr(static_cast<ControlBlock*>(blocks + i),
+                               &blocks[i].object, AdoptTag()));
+    if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
+      result.back().get()->weak_ptr_ = result.back();
+    }
+  }
+  return result;
 }
 
-template <typename T>
-SharedPtr<T>& SharedPtr<T>::operator=(SharedPtr&& ptr) {
+template <typename T, typename Policy>
+SharedPtr<T, Policy>& SharedPtr<T, Policy>::operator=(
+    SharedPtr&& ptr) noexcept {
   auto copy = std::move(ptr);
   swap(copy);
   return *this;
 }
 
-template <typename T>
-void SharedPtr<T>::clear() {
+template <typename T, typename Policy>
+void SharedPtr<T, Policy>::clear() {
   if (control_block_ == nullptr) {
     return;
   }
-  --control_block_->shared_count;
-  if (control_block_->shared_count != 0) {
-    return;
-  }
-  ++control_block_->shared_count;
-  control_block_->use_deleter();
-  --control_block_->shared_count;
-  if (control_block_->weak_count != 0) {
-    return;
-  }
-  control_block_->dispose();
+  control_block_->release_shared();
 }
 
-template <typename T>
+template <typename T, typename Policy>
 template <typename U, typename Allocator, typename Deleter>
-ControlBlockRegular<U, Deleter, Allocator>* SharedPtr<T>::create_by_ptr(
-    U* ptr, Allocator allocator, Deleter deleter) {
+ControlBlockRegular<U, Deleter, Allocator, Policy>*
+SharedPtr<T, Policy>::create_by_ptr(U* ptr, Allocator allocator,
+                                    Deleter deleter) {
+  using Block = ControlBlockRegular<U, Deleter, Allocator, Policy>;
   using NewAlloc =
-      typename std::allocator_traits<Allocator>::template rebind_alloc<
-          ControlBlockRegular<U, Deleter, Allocator>>;
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Block>;
   NewAlloc new_allocator = allocator;
-  ControlBlockRegular<U, Deleter, Allocator>* block =
-      std::allocator_traits<NewAlloc>::allocate(new_allocator, 1);
+  Block* block = std::allocator_traits<NewAlloc>::allocate(new_allocator, 1);
   std::construct_at(block, ptr, deleter, allocator);
   return block;
 }
-template <typename T>
+template <typename T, typename Policy>
 template <typename U, typename Deleter, typename Allocator>
-SharedPtr<T>::SharedPtr(U* ptr, Deleter deleter, Allocator allocator)
-    : control_block_(nullptr) {
+SharedPtr<T, Policy>::SharedPtr(U* ptr, Deleter deleter, Allocator allocator)
+    : ptr_(ptr),
+      control_block_(nullptr) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
   if (ptr != nullptr) {
     control_block_ = create_by_ptr(ptr, allocator, deleter);
   }
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     if (get() != nullptr) {
       get()->weak_ptr_ = *this;
     }
   }
 }
 
-template <typename T>
-WeakPtr<T>::WeakPtr(const WeakPtr& other)
-    : control_block_(other.control_block_) {
-  ++control_block_->weak_count;
-}
-
-template <typename T>
-WeakPtr<T>::WeakPtr(WeakPtr&& ptr)
-    : control_block_(ptr.control_block_) {
-  ++control_block_->weak_count;
-  auto tmp = WeakPtr(SharedPtr<T>());
-  ptr.swap(tmp);
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
-    this->weak_ptr_.reset(get());
+template <typename T, typename Policy>
+WeakPtr<T, Policy>::WeakPtr(const WeakPtr& other)
+    : ptr_(other.ptr_),
+      control_block_(other.control_block_) {
+  if (control_block_ != nullptr) {
+    control_block_->add_weak();
   }
 }
-template <typename T>
-WeakPtr<T>& WeakPtr<T>::operator=(WeakPtr&& other) {
-  WeakPtr<T> copy = std::move(other);
+
+template <typename T, typename Policy>
+WeakPtr<T, Policy>& WeakPtr<T, Policy>::operator=(WeakPtr&& other) {
+  WeakPtr copy = std::move(other);
   swap(copy);
   return *this;
 }
-template <typename T>
-size_t WeakPtr<T>::use_count() const noexcept {
+template <typename T, typename Policy>
+size_t WeakPtr<T, Policy>::use_count() const noexcept {
   if (control_block_ == nullptr) {
     return 0;
   }
-  return control_block_->shared_count;
+  return control_block_->use_count();
 }
-template <typename T>
-WeakPtr<T>::~WeakPtr() {
+template <typename T, typename Policy>
+WeakPtr<T, Policy>::~WeakPtr() {
   if (control_block_ == nullptr) {
     return;
   }
-  --control_block_->weak_count;
-  if (control_block_->shared_count == 0 && control_block_->weak_count == 0) {
-    control_block_->dispose();
-  }
+  control_block_->release_weak();
 }
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-WeakPtr<T>::WeakPtr(WeakPtr<U> other)
-    : control_block_(other.control_block_) {
+WeakPtr<T, Policy>::WeakPtr(WeakPtr<U, Policy> other)
+    : ptr_(other.ptr_),
+      control_block_(other.control_block_) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
-  ++control_block_->weak_count;
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  if (control_block_ != nullptr) {
+    control_block_->add_weak();
+  }
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     this->weak_ptr_ = *this;
   }
 }
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-WeakPtr<T>& WeakPtr<T>::operator=(SharedPtr<U> other) {
-  WeakPtr<T> copy = other;
+WeakPtr<T, Policy>& WeakPtr<T, Policy>::operator=(SharedPtr<U, Policy> other) {
+  WeakPtr copy = other;
   swap(copy);
   return *this;
 }
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-WeakPtr<T>::WeakPtr(SharedPtr<U> other)
-    : control_block_(other.control_block_) {
+WeakPtr<T, Policy>::WeakPtr(SharedPtr<U, Policy> other)
+    : ptr_(other.ptr_),
+      control_block_(other.control_block_) {
   static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
   if (control_block_ != nullptr) {
-    ++control_block_->weak_count;
+    control_block_->add_weak();
   }
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
+  if constexpr (std::is_base_of_v<EnableSharedFromThis<T, Policy>, T>) {
     if (get() != nullptr) {
       get()->weak_ptr_ = *this;
     }
   }
 }
 
-template <typename T, typename Allocator, typename... Args>
-SharedPtr<T> allocateShared(const Allocator& allocator, Args&&... args) {
-  return SharedPtr<T>::construct(allocator, std::forward<Args>(args)...);
+template <typename T, typename Policy = SingleThreaded, typename Allocator,
+          typename... Args>
+SharedPtr<T, Policy> allocateShared(const Allocator& allocator,
+                                    Args&&... args) {
+  return SharedPtr<T, Policy>::construct(allocator,
+                                         std::forward<Args>(args)...);
+}
+
+template <typename T, typename Policy = SingleThreaded, typename... Args>
+SharedPtr<T, Policy> makeShared(Args&&... args) {
+  return SharedPtr<T, Policy>::construct(std::allocator<T>(),
+                                         std::forward<Args>(args)...);
+}
+
+// count objects built from the same arguments, with their control blocks
+// laid out next to each other in one allocation
+template <typename T, typename Policy = SingleThreaded, typename... Args>
+std::vector<SharedPtr<T, Policy>> makeSharedBatch(size_t count,
+                                                  const Args&... args) {
+  return SharedPtr<T, Policy>::construct_batch(count, args...);
+}
+
+// per-thread state in front of a structure shared by all threads. a thread
+// builds its state on the first local() call and destroys it at exit;
+// after that local() returns nullptr, for thread_locals destroyed later.
+// shared() is never destroyed, threads may exit during static destruction
+template <typename Shared, typename State>
+class PerThread {
+ public:
+  static Shared& shared() {
+    static Shared* shared = new Shared();
+    return *shared;
+  }
+
+  static State* local();
+
+ private:
+  struct Holder {
+    State state;
+
+    Holder() {
+      current_ = &state;
+    }
+
+    ~Holder() {
+      current_ = nullptr;
+      exited_ = true;
+    }
+  };
+
+  // trivially destructible, so still readable once the holder is gone
+  static thread_local State* current_;
+  static thread_local bool exited_;
+};
+
+template <typename Shared, typename State>
+thread_local State* PerThread<Shared, State>::current_ = nullptr;
+
+template <typename Shared, typename State>
+thread_local bool PerThread<Shared, State>::exited_ = false;
+
+template <typename Shared, typename State>
+State* PerThread<Shared, State>::local() {
+  if (current_ == nullptr && !exited_) {
+    thread_local Holder holder;
+  }
+  return current_;
 }
 
+// fixed-size blocks carved from slabs that are never given back, so a block
+// may be freed on any thread: it goes to the freeing thread's list, which
+// spills half of itself into the shared depot once it grows long and the
+// rest when the thread exits. the depot is a stack of chains, so a refill
+// or a spill takes the same time however many blocks are free
+template <size_t Size, size_t Align>
+class BlockPool {
+ public:
+  static void* allocate();
+  static void deallocate(void* block) noexcept;
+
+ private:
+  // the first block of a chain in the depot also links the next chain
+  struct FreeBlock {
+    FreeBlock* next;
+    FreeBlock* next_chain;
+    size_t length;
+  };
+
+  static constexpr size_t block_align = std::max(Align, alignof(FreeBlock));
+  static constexpr size_t block_size =
+      (std::max(Size, sizeof(FreeBlock)) + block_align - 1) / block_align *
+      block_align;
+  static constexpr size_t slab_blocks =
+      std::max<size_t>(16384 / block_size, 16);
+  static constexpr size_t spill_threshold = 2 * slab_blocks;
+
+  struct Depot {
+    std::mutex mutex;
+    FreeBlock* chains = nullptr;
+  };
+
+  struct Local {
+    FreeBlock* free = nullptr;
+    size_t count = 0;
+    std::byte* next = nullptr;
+    std::byte* end = nullptr;
+
+    ~Local();
+  };
+
+  using Threads = PerThread<Depot, Local>;
+
+  static void push_chain(FreeBlock* first, size_t length) noexcept;
+  static FreeBlock* pop_chain() noexcept;
+};
+
+template <size_t Size, size_t Align>
+void* BlockPool<Size, Align>::allocate() {
+  Local* cache = Threads::local();
+  if (cache == nullptr) {
+    return ::operator new(block_size, std::align_val_t(block_align));
+  }
+  if (cache->free == nullptr && cache->next == cache->end) {
+    if (FreeBlock* chain = pop_chain(); chain != nullptr) {
+      cache->free = chain;
+      cache->count = chain->length;
+    }
+  }
+  if (cache->free != nullptr) {
+    --cache->count;
+    return std::exchange(cache->free, cache->free->next);
+  }
+  if (cache->next == cache->end) {
+    cache->next = static_cast<std::byte*>(::operator new(
+        slab_blocks * block_size, std::align_val_t(block_align)));
+    cache->end = cache->next + slab_blocks * block_size;
+  }
+  return std::exchange(cache->next, cache->next + block_size);
+}
+
+// the recently freed half stays, it is the likeliest to be in cache
+template <size_t Size, size_t Align>
+void BlockPool<Size, Align>::deallocate(void* block) noexcept {
+  Local* cache = Threads::local();
+  if (cache == nullptr) {
+    push_chain(::new (block) FreeBlock{nullptr, nullptr, 0}, 1);
+    return;
+  }
+  cache->free = ::new (block) FreeBlock{cache->free, nullptr, 0};
+  if (++cache->count < spill_threshold) {
+    return;
+  }
+  auto* last_kept = cache->free;
+  for (size_t i = 1; i < slab_blocks; ++i) {
+    last_kept = last_kept->next;
+  }
+  push_chain(std::exchange(last_kept->next, nullptr),
+             cache->count - slab_blocks);
+  cache->count = slab_blocks;
+}
+
+template <size_t Size, size_t Align>
+void BlockPool<Size, Align>::push_chain(FreeBlock* first,
+                                        size_t length) noexcept {
+  Depot& shared = Threads::shared();
+  std::lock_guard lock(shared.mutex);
+  first->length = length;
+  first->next_chain = shared.chains;
+  shared.chains = first;
+}
+
+template <size_t Size, size_t Align>
+auto BlockPool<Size, Align>::pop_chain() noexcept -> FreeBlock* {
+  Depot& shared = Threads::shared();
+  std::lock_guard lock(shared.mutex);
+  FreeBlock* chain = shared.chains;
+  if (chain != nullptr) {
+    shared.chains = chain->next_chain;
+  }
+  return chain;
+}
+
+template <size_t Size, size_t Align>
+BlockPool<Size, Align>::Local::~Local() {
+  // the rest of the slab is handed over along with the freed blocks
+  for (; next != end; next += block_size) {
+    free = ::new (next) FreeBlock{free, nullptr, 0};
+    ++count;
+  }
+  if (free != nullptr) {
+    push_chain(free, count);
+  }
+}
+
+// single objects come from a pool of blocks of their size, so the control
+// blocks of allocateShared<T>(PooledAllocator<T>()) stay off the heap;
+// arrays go to std::allocator
+template <typename T>
+class PooledAllocator {
+ public:
+  using value_type = T;
+
+  PooledAllocator() noexcept = default;
+
+  template <typename U>
+  PooledAllocator(const PooledAllocator<U>&) noexcept {
+  }
+
+  T* allocate(size_t count) {
+    if (count != 1) {
+      return std::allocator<T>().allocate(count);
+    }
+    return static_cast<T*>(BlockPool<sizeof(T), alignof(T)>::allocate());
+  }
+
+  void deallocate(T* ptr, size_t count) noexcept {
+    if (count != 1) {
+      std::allocator<T>().deallocate(ptr, count);
+      return;
+    }
+    BlockPool<sizeof(T), alignof(T)>::deallocate(ptr);
+  }
+
+  template <typename U>
+  bool operator==(const PooledAllocator<U>&) const noexcept {
+    return true;
+  }
+};
+
+// epoch-based reclamation behind DeferredRelease. an object retired while
+// some thread holds a Guard is destroyed only after that guard is gone, so
+// under a guard a WeakPtr that is not expired may be read through get()
+// without taking a count. retired objects are destroyed in batches: every
+// retire_batch retirements of a thread, at quiescent(), at thread exit, or
+// on the background thread once it is started
+class Reclaimer {
+  static constexpr uint64_t unpinned = std::numeric_limits<uint64_t>::max();
+
+  struct ThreadState;
+
+ public:
+  class Guard {
+   public:
+    Guard();
+    ~Guard();
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    ThreadState* state_;
+    // pinned by the guard itself once the thread's state is gone
+    std::atomic<uint64_t> pin_ = unpinned;
+  };
+
+  // destroys what this thread and exited threads retired, as far as no
+  // guard still protects it; must not be called under a guard of its own
+  static void quiescent();
+
+  // from now on threads hand their batches to a thread that destroys them
+  // every interval, so the owners never run the destructors themselves
+  static void start_background(
+      std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+
+  static void stop_background();
+
+  static void retire(BaseControlBlock<DeferredRelease>* block);
+
+ private:
+  using Block = BaseControlBlock<DeferredRelease>;
+
+  struct Retired {
+    Block* block;
+    uint64_t epoch;
+  };
+
+  static constexpr size_t retire_batch = 64;
+
+  struct ThreadState {
+    // the epoch seen by the outermost guard, unpinned outside of guards
+    std::atomic<uint64_t> pinned = unpinned;
+    size_t depth = 0;
+    // destructors retire more objects, they wait for the next batch
+    bool collecting = false;
+    std::vector<Retired> retired;
+
+    ThreadState();
+    ~ThreadState();
+  };
+
+  struct Shared {
+    std::mutex mutex;
+    std::atomic<uint64_t> epoch = 1;
+    std::vector<const std::atomic<uint64_t>*> pins;
+    // left by exited threads or handed to the background thread
+    std::vector<Retired> pending;
+    std::condition_variable_any wake;
+    bool background_running = false;
+    std::jthread background;
+  };
+
+  using Threads = PerThread<Shared, ThreadState>;
+
+  static void flush(ThreadState& state);
+  static void collect(std::vector<Retired>& retired);
+  static void take_pending(std::vector<Retired>& retired);
+  static void run_background(std::stop_token stop,
+                             std::chrono::milliseconds interval);
+};
+
+template <typename Block>
+void DeferredRelease::retire(Block* block) {
+  Reclaimer::retire(block);
+}
+
+inline Reclaimer::Guard::Guard()
+    : state_(Threads::local()) {
+  Shared& all = Threads::shared();
+  if (state_ == nullptr) {
+    pin_.store(all.epoch.load());
+    std::lock_guard lock(all.mutex);
+    all.pins.push_back(&pin_);
+  } else if (state_->depth++ == 0) {
+    state_->pinned.store(all.epoch.load());
+  }
+}
+
+inline Reclaimer::Guard::~Guard() {
+  if (state_ == nullptr) {
+    Shared& all = Threads::shared();
+    std::lock_guard lock(all.mutex);
+    std::erase(all.pins, &pin_);
+  } else if (--state_->depth == 0) {
+    state_->pinned.store(unpinned, std::memory_order_release);
+  }
+}
+
+inline Reclaimer::ThreadState::ThreadState() {
+  Shared& all = Threads::shared();
+  std::lock_guard lock(all.mutex);
+  all.pins.push_back(&pinned);
+}
+
+// what the thread retires from here on goes to pending directly
+inline Reclaimer::ThreadState::~ThreadState() {
+  collecting = true;
+  collect(retired);
+  Shared& all = Threads::shared();
+  std::lock_guard lock(all.mutex);
+  std::erase(all.pins, &pinned);
+  all.pending.insert(all.pending.end(), retired.begin(), retired.end());
+}
+
+inline void Reclaimer::retire(Block* block) {
+  Shared& all = Threads::shared();
+  Retired entry{block, all.epoch.load()};
+  ThreadState* state = Threads::local();
+  if (state == nullptr) {
+    std::lock_guard lock(all.mutex);
+    all.pending.push_back(entry);
+    return;
+  }
+  state->retired.push_back(entry);
+  if (state->retired.size() >= retire_batch && !state->collecting) {
+    flush(*state);
+  }
+}
+
+inline void Reclaimer::quiescent() {
+  ThreadState* state = Threads::local();
+  if (state == nullptr || state->collecting) {
+    return;
+  }
+  take_pending(state->retired);
+  state->collecting = true;
+  collect(state->retired);
+  state->collecting = false;
+}
+
+inline void Reclaimer::flush(ThreadState& state) {
+  Shared& all = Threads::shared();
+  {
+    std::lock_guard lock(all.mutex);
+    if (all.background_running) {
+      all.pending.insert(all.pending.end(), state.retired.begin(),
+                         state.retired.end());
+      state.retired.clear();
+      all.wake.notify_one();
+      return;
+    }
+  }
+  state.collecting = true;
+  collect(state.retired);
+  state.collecting = false;
+}
+
+// everything retired before the epoch is advanced and before the oldest
+// pin is safe; the destructors may retire into retired as it is rebuilt
+inline void Reclaimer::collect(std::vector<Retired>& retired) {
+  if (retired.empty()) {
+    return;
+  }
+  Shared& all = Threads::shared();
+  uint64_t safe = all.epoch.fetch_add(1) + 1;
+  {
+    std::lock_guard lock(all.mutex);
+    for (const auto* pin : all.pins) {
+      safe = std::min(safe, pin->load());
+    }
+  }
+  auto batch = std::exchange(retired, {});
+  for (const auto& entry : batch) {
+    if (entry.epoch < safe) {
+      entry.block->use_deleter();
+      entry.block->release_weak();
+    } else {
+      retired.push_back(entry);
+    }
+  }
+}
+
+inline void Reclaimer::take_pending(std::vector<Retired>& retired) {
+  Shared& all = Threads::shared();
+  std::lock_guard lock(all.mutex);
+  retired.insert(retired.end(), all.pending.begin(), all.pending.end());
+  all.pending.clear();
+}
+
+inline void Reclaimer::start_background(std::chrono::milliseconds interval) {
+  Shared& all = Threads::shared();
+  std::lock_guard lock(all.mutex);
+  if (all.background_running) {
+    return;
+  }
+  all.background_running = true;
+  all.background = std::jthread(run_background, interval);
+}
+
+// what the background thread could not destroy yet is left pending
+inline void Reclaimer::stop_background() {
+  Shared& all = Threads::shared();
+  std::jthread background;
+  {
+    std::lock_guard lock(all.mutex);
+    all.background_running = false;
+    background = std::move(all.background);
+  }
+  background.request_stop();
+  all.wake.notify_one();
+}
+
+// the objects its own destructors retire come back through pending
+inline void Reclaimer::run_background(std::stop_token stop,
+                                      std::chrono::milliseconds interval) {
+  Shared& all = Threads::shared();
+  std::vector<Retired> retired;
+  while (!stop.stop_requested()) {
+    {
+      std::unique_lock lock(all.mutex);
+      all.wake.wait_for(lock, stop, interval, [&all] {
+        return all.pending.size() >= retire_batch;
+      });
+    }
+    take_pending(retired);
+    collect(retired);
+  }
+  take_pending(retired);
+  collect(retired);
+  std::lock_guard lock(all.mutex);
+  all.pending.insert(all.pending.end(), retired.begin(), retired.end());
+}
+
+// keeps the count inside the object, IntrusivePtr<T> finds the hooks below
+// by ADL, so a type may also define its own intrusive_add_ref/release
+template <typename T, typename Policy = SingleThreaded>
+class RefCounted {
+ public:
+  size_t use_count() const noexcept {
+    return Policy::load(ref_count_);
+  }
+
+ protected:
+  RefCounted() noexcept
+      : ref_count_(0) {
+  }
+
+  // a copy is a new object and starts with no owners of its own
+  RefCounted(const RefCounted&) noexcept
+      : RefCounted() {
+  }
+
+  RefCounted& operator=(const RefCounted&) noexcept {
+    return *this;
+  }
+
+  ~RefCounted() = default;
+
+ private:
+  friend void intrusive_add_ref(const RefCounted* object) noexcept {
+    Policy::increment(object->ref_count_);
+  }
+
+  friend void intrusive_release(const RefCounted* object) noexcept {
+    if (Policy::decrement(object->ref_count_)) {
+      delete static_cast<const T*>(object);
+    }
+  }
+
+  mutable typename Policy::Counter ref_count_;
+};
+
+template <typename T>
+class IntrusivePtr {
+  template <typename U>
+  friend class IntrusivePtr;
+
+  T* ptr_;
+
+ public:
+  IntrusivePtr() noexcept
+      : ptr_(nullptr) {
+  }
+
+  // add_ref = false adopts a reference the caller already holds
+  IntrusivePtr(T* ptr, bool add_ref = true)
+      : ptr_(ptr) {
+    if (ptr_ != nullptr && add_ref) {
+      intrusive_add_ref(ptr_);
+    }
+  }
+
+  IntrusivePtr(const IntrusivePtr& other)
+      : IntrusivePtr(other.ptr_) {
+  }
+
+  template <typename U>
+  IntrusivePtr(const IntrusivePtr<U>& other)
+      : IntrusivePtr(other.ptr_) {
+    static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
+  }
+
+  IntrusivePtr(IntrusivePtr&& other) noexcept
+      : ptr_(std::exchange(other.ptr_, nullptr)) {
+  }
+
+  template <typename U>
+  IntrusivePtr(IntrusivePtr<U>&& other) noexcept
+      : ptr_(std::exchange(other.ptr_, nullptr)) {
+    static_assert(std::is_base_of_v<T, U> || std::is_same_v<T, U>);
+  }
+
+  IntrusivePtr& operator=(const IntrusivePtr& other) {
+    IntrusivePtr copy = other;
+    swap(copy);
+    return *this;
+  }
+
+  IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+    IntrusivePtr copy = std::move(other);
+    swap(copy);
+    return *this;
+  }
+
+  ~IntrusivePtr() {
+    if (ptr_ != nullptr) {
+      intrusive_release(ptr_);
+    }
+  }
+
+  T* get() const noexcept {
+    return ptr_;
+  }
+
+  T& operator*() const noexcept {
+    return *ptr_;
+  }
+
+  T* operator->() const noexcept {
+    return ptr_;
+  }
+
+  void reset(T* ptr = nullptr) {
+    IntrusivePtr copy(ptr);
+    swap(copy);
+  }
+
+  // gives up ownership without releasing the reference
+  T* detach() noexcept {
+    return std::exchange(ptr_, nullptr);
+  }
+
+  void swap(IntrusivePtr& other) noexcept {
+    std::swap(ptr_, other.ptr_);
+  }
+};
+
 template <typename T, typename... Args>
-SharedPtr<T> makeShared(Args&&... args) {
-  return SharedPtr<T>::construct(std::allocator<T>(),
-                                 std::forward<Args>(args)...);
+IntrusivePtr<T> makeIntrusive(Args&&... args) {
+  return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
 }
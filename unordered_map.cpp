@@ -1,7 +1,24 @@
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 template <typename T, typename Allocator = std::allocator<T>>
@@ -38,6 +55,41 @@ class List {
 
   void erase(const_iterator iter) noexcept;
 
+  // splice, merge and sort only relink nodes, nothing is allocated and
+  // iterators stay valid; allocators of both lists must compare equal
+
+  void splice(const_iterator iter, List& list) noexcept;
+
+  void splice(const_iterator iter, List&& list) noexcept {
+    splice(iter, list);
+  }
+
+  void splice(const_iterator iter, List& list, const_iterator other) noexcept;
+
+  // linear in the length of the range unless list is *this
+  void splice(const_iterator iter, List& list, const_iterator first,
+              const_iterator last) noexcept;
+
+  template <typename Compare = std::less<>>
+  void merge(List& list, Compare comp = Compare());
+
+  // stable bottom-up merge sort, if comp throws every node is kept
+  template <typename Compare = std::less<>>
+  void sort(Compare comp = Compare());
+
+  // links nodes[first, last) to their neighbours in nodes, which has to
+  // hold every node of the list once; disjoint ranges may be linked from
+  // different threads, the list is whole again once all of nodes is done
+  void relink(std::span<const iterator> nodes, size_t first,
+              size_t last) noexcept;
+
+  class NodeHandle;
+
+  NodeHandle extract(const_iterator iter) noexcept;
+
+  // an empty handle is ignored and end() is returned
+  iterator insert(const_iterator iter, NodeHandle&& handle) noexcept;
+
   iterator end() {
     return &fake_node_;
   }
@@ -125,28 +177,14 @@ class List {
         node_alloc_(alloc_),
         size_(0){};
 
-  List(List&& list)
-      : List(AllocTraits::select_on_container_copy_construction(
-            list.get_allocator())) {
-    for (auto&& item : list) {
-      emplace_back(std::move(item));
-    }
-    list.clear();
-  }
-
-  List& operator=(List&& list) {
-    List&& copy = std::move(list);
-    std::swap(*this, copy);
-    return *this;
+  List(List&& list) noexcept
+      : alloc_(std::move(list.alloc_)),
+        node_alloc_(alloc_),
+        size_(0) {
+    steal(list);
   }
 
-  void insert(const_iterator iter, Node* new_node) {
-    BaseNode* current = iter.node;
-    BaseNode* previous = (--iter).node;
-    previous->next = new_node;
-    current->prev = new_node;
-    ++size_;
-  }
+  List& operator=(List&& list);
 
   List(size_t count, const T& value = T(),
        const Allocator& allocator = Allocator());
@@ -175,6 +213,20 @@ class List {
   using NodeTraits = std::allocator_traits<NodeAlloc>;
   using AllocTraits = std::allocator_traits<Allocator>;
 
+  void steal(List& list) noexcept;
+
+  static T& value_of(BaseNode* node) noexcept {
+    return static_cast<Node*>(node)->value;
+  }
+
+  // moves [first, last) in front of pos, the nodes may come from another
+  // ring and pos must not be inside the range
+  static void transfer(BaseNode* pos, BaseNode* first,
+                       BaseNode* last) noexcept;
+
+  template <typename Compare>
+  static void merge_rings(BaseNode& into, BaseNode& from, Compare& comp);
+
   [[no_unique_address]] Allocator alloc_;
   [[no_unique_address]] NodeAlloc node_alloc_;
   BaseNode fake_node_;
@@ -216,6 +268,40 @@ List<T, Allocator>& List<T, Allocator>::operator=(const List& list) {
   return *this;
 }
 
+template <typename T, typename Allocator>
+List<T, Allocator>& List<T, Allocator>::operator=(List&& list) {
+  if (this == &list) {
+    return *this;
+  }
+  clear();
+  if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+    alloc_ = std::move(list.alloc_);
+    node_alloc_ = NodeAlloc(alloc_);
+  } else if (!(alloc_ == list.alloc_)) {
+    for (auto&& item : list) {
+      emplace_back(std::move(item));
+    }
+    list.clear();
+    return *this;
+  }
+  steal(list);
+  return *this;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::steal(List& list) noexcept {
+  if (list.is_empty()) {
+    return;
+  }
+  fake_node_.next = list.fake_node_.next;
+  fake_node_.prev = list.fake_node_.prev;
+  fake_node_.next->prev = &fake_node_;
+  fake_node_.prev->next = &fake_node_;
+  size_ = list.size_;
+  list.fake_node_.next = list.fake_node_.prev = &list.fake_node_;
+  list.size_ = 0;
+}
+
 template <typename T, typename Allocator>
 bool List<T, Allocator>::operator==(const List& list) const {
   if (list.size() != size()) {
@@ -260,6 +346,175 @@ List<T, Allocator>::List(size_t count, const T& value,
   }
 }
 
+template <typename T, typename Allocator>
+void List<T, Allocator>::transfer(BaseNode* pos, BaseNode* first,
+                                  BaseNode* last) noexcept {
+  if (first == last) {
+    return;
+  }
+  BaseNode* tail = last->prev;
+  first->prev->next = last;
+  last->prev = first->prev;
+  first->prev = pos->prev;
+  tail->next = pos;
+  pos->prev->next = first;
+  pos->prev = tail;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::splice(List::const_iterator iter,
+                                List& list) noexcept {
+  if (&list == this) {
+    return;
+  }
+  transfer(iter.node, list.fake_node_.next, &list.fake_node_);
+  size_ += std::exchange(list.size_, 0);
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::splice(List::const_iterator iter, List& list,
+                                List::const_iterator other) noexcept {
+  BaseNode* node = other.node;
+  BaseNode* current = iter.node;
+  if (node == current || node->next == current) {
+    return;
+  }
+  transfer(current, node, node->next);
+  --list.size_;
+  ++size_;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::splice(List::const_iterator iter, List& list,
+                                List::const_iterator first,
+                                List::const_iterator last) noexcept {
+  if (&list != this) {
+    size_t count = std::distance(first, last);
+    list.size_ -= count;
+    size_ += count;
+  }
+  transfer(iter.node, first.node, last.node);
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::relink(std::span<const iterator> nodes, size_t first,
+                                size_t last) noexcept {
+  for (size_t i = first; i < last; ++i) {
+    BaseNode* node = nodes[i].node;
+    node->prev = i == 0 ? &fake_node_ : nodes[i - 1].node;
+    node->next = i + 1 == nodes.size() ? &fake_node_ : nodes[i + 1].node;
+  }
+  if (first < last && first == 0) {
+    fake_node_.next = nodes.front().node;
+  }
+  if (first < last && last == nodes.size()) {
+    fake_node_.prev = nodes.back().node;
+  }
+}
+
+// runs of from that belong in front of the same node of into are moved
+// with one transfer
+template <typename T, typename Allocator>
+template <typename Compare>
+void List<T, Allocator>::merge_rings(BaseNode& into, BaseNode& from,
+                                     Compare& comp) {
+  BaseNode* iter = into.next;
+  while (from.next != &from) {
+    BaseNode* first = from.next;
+    while (iter != &into && !comp(value_of(first), value_of(iter))) {
+      iter = iter->next;
+    }
+    if (iter == &into) {
+      transfer(&into, first, &from);
+      return;
+    }
+    BaseNode* last = first->next;
+    while (last != &from && comp(value_of(last), value_of(iter))) {
+      last = last->next;
+    }
+    transfer(iter, first, last);
+  }
+}
+
+template <typename T, typename Allocator>
+template <typename Compare>
+void List<T, Allocator>::merge(List& list, Compare comp) {
+  if (&list == this) {
+    return;
+  }
+  try {
+    merge_rings(fake_node_, list.fake_node_, comp);
+  } catch (...) {
+    size_t rest = std::distance(list.begin(), list.end());
+    size_ += list.size_ - rest;
+    list.size_ = rest;
+    throw;
+  }
+  size_ += std::exchange(list.size_, 0);
+}
+
+// bins[i] is empty or holds a sorted run of 2^i nodes, every node always
+// sits in exactly one ring so that a throwing comp loses nothing
+template <typename T, typename Allocator>
+template <typename Compare>
+void List<T, Allocator>::sort(Compare comp) {
+  if (size_ < 2) {
+    return;
+  }
+  constexpr size_t bin_count = sizeof(size_t) * CHAR_BIT;
+  BaseNode bins[bin_count];
+  BaseNode carry;
+  size_t used = 0;
+  try {
+    while (fake_node_.next != &fake_node_) {
+      transfer(&carry, fake_node_.next, fake_node_.next->next);
+      size_t i = 0;
+      for (; i < used && bins[i].next != &bins[i]; ++i) {
+        merge_rings(bins[i], carry, comp);
+        transfer(&carry, bins[i].next, &bins[i]);
+      }
+      transfer(&bins[i], carry.next, &carry);
+      used = std::max(used, i + 1);
+    }
+    for (size_t i = 1; i < used; ++i) {
+      merge_rings(bins[i], bins[i - 1], comp);
+    }
+  } catch (...) {
+    transfer(&fake_node_, carry.next, &carry);
+    for (size_t i = 0; i < used; ++i) {
+      transfer(&fake_node_, bins[i].next, &bins[i]);
+    }
+    throw;
+  }
+  transfer(&fake_node_, bins[used - 1].next, &bins[used - 1]);
+}
+
+template <typename T, typename Allocator>
+typename List<T, Allocator>::NodeHandle List<T, Allocator>::extract(
+    List::const_iterator iter) noexcept {
+  BaseNode* node = iter.node;
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  --size_;
+  return NodeHandle(static_cast<Node*>(node), node_alloc_);
+}
+
+template <typename T, typename Allocator>
+typename List<T, Allocator>::iterator List<T, Allocator>::insert(
+    List::const_iterator iter, NodeHandle&& handle) noexcept {
+  if (handle.empty()) {
+    return end();
+  }
+  BaseNode* node = handle.release();
+  BaseNode* current = iter.node;
+  node->prev = current->prev;
+  node->next = current;
+  current->prev->next = node;
+  current->prev = node;
+  ++size_;
+  return node;
+}
+
 template <typename T, typename Allocator>
 void List<T, Allocator>::erase(List::const_iterator iter) noexcept {
   Node& current = static_cast<Node&>(*iter.node);
@@ -279,7 +534,7 @@ void List<T, Allocator>::emplace(List::const_iterator iter, Args&&... args) {
   BaseNode* previous = (--iter).node;
   Node* new_node = NodeTraits::allocate(node_alloc_, 1);
   try {
-    NodeTraits::construct(node_alloc_, new_node, previous, current, alloc_,
+    NodeTraits::construct(node_alloc_, new_node, previous, current,
                           std::forward<Args>(args)...);
   } catch (...) {
     NodeTraits::deallocate(node_alloc_, new_node, 1);
@@ -313,24 +568,83 @@ struct List<T, Allocator>::Node : public BaseNode {
   using pointer = value_type*;
 
   template <typename... Args>
-  Node(BaseNode* prev, BaseNode* next, Allocator allocator_1, Args&&... args)
+  Node(BaseNode* prev, BaseNode* next, Args&&... args)
       : BaseNode(prev, next),
-        alloc(allocator_1),
-        value(AllocTraits::allocate(alloc, 1)) {
-    AllocTraits ::construct(alloc, value, std::forward<Args>(args)...);
+        value(std::forward<Args>(args)...) {
   }
 
-  ~Node() {
-    AllocTraits ::destroy(alloc, value);
-    AllocTraits ::deallocate(alloc, value, 1);
+  pointer get_value() {
+    return &value;
   }
 
-  pointer get_value() {
-    return value;
+  value_type value;
+};
+
+// owns a node taken out of a list together with a copy of its allocator,
+// a handle that is never inserted again destroys the node
+template <typename T, typename Allocator>
+class List<T, Allocator>::NodeHandle {
+ public:
+  NodeHandle() noexcept = default;
+
+  NodeHandle(NodeHandle&& handle) noexcept
+      : node_(std::exchange(handle.node_, nullptr)),
+        alloc_(std::move(handle.alloc_)) {
+  }
+
+  NodeHandle& operator=(NodeHandle&& handle) noexcept {
+    if (this != &handle) {
+      reset();
+      node_ = std::exchange(handle.node_, nullptr);
+      alloc_ = std::move(handle.alloc_);
+    }
+    return *this;
+  }
+
+  ~NodeHandle() {
+    reset();
+  }
+
+  bool empty() const noexcept {
+    return node_ == nullptr;
+  }
+
+  explicit operator bool() const noexcept {
+    return !empty();
+  }
+
+  T& value() const noexcept {
+    return node_->value;
+  }
+
+  Allocator get_allocator() const {
+    return Allocator(*alloc_);
+  }
+
+ private:
+  friend List;
+
+  NodeHandle(Node* node, const NodeAlloc& alloc) noexcept
+      : node_(node),
+        alloc_(alloc) {
+  }
+
+  Node* release() noexcept {
+    alloc_.reset();
+    return std::exchange(node_, nullptr);
+  }
+
+  void reset() noexcept {
+    if (node_ != nullptr) {
+      NodeTraits::destroy(*alloc_, node_);
+      NodeTraits::deallocate(*alloc_, node_, 1);
+      node_ = nullptr;
+    }
+    alloc_.reset();
   }
 
-  Allocator alloc;
-  pointer value;
+  Node* node_ = nullptr;
+  std::optional<NodeAlloc> alloc_;
 };
 
 template <typename T, typename Allocator>
@@ -377,11 +691,11 @@ struct List<T, Allocator>::Iterator {
   }
 
   pointer operator->() {
-    return static_cast<Node*>(node)->get_value();
+    return &static_cast<Node*>(node)->value;
   }
 
   reference operator*() {
-    return *static_cast<Node*>(node)->get_value();
+    return static_cast<Node*>(node)->value;
   }
 
   bool operator==(Iterator iterator) const noexcept {
@@ -389,9 +703,263 @@ struct List<T, Allocator>::Iterator {
   }
 };
 
+// a hint only, compiles to nothing where the builtin is missing
+inline void prefetch(const void* ptr) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(ptr);
+#else
+  (void)ptr;
+#endif
+}
+
+inline constexpr size_t max_parallel_workers = 64;
+
+// splits [0, count) into workers contiguous ranges and calls
+// body(worker, first, last) for each, the calling thread takes range 0 and
+// a range whose thread fails to start runs inline; the first exception of a
+// body is rethrown once every range is done, nothing else throws
+template <typename Body>
+void run_parallel(size_t count, size_t workers, Body&& body) {
+  assert(workers > 0 && workers <= max_parallel_workers);
+  std::array<std::exception_ptr, max_parallel_workers> errors;
+  auto run = [&](size_t worker) noexcept {
+    try {
+      body(worker, count * worker / workers, count * (worker + 1) / workers);
+    } catch (...) {
+      errors[worker] = std::current_exception();
+    }
+  };
+  {
+    std::array<std::jthread, max_parallel_workers> threads;
+    for (size_t worker = 1; worker < workers; ++worker) {
+      try {
+        threads[worker] = std::jthread(run, worker);
+      } catch (...) {
+        run(worker);
+      }
+    }
+    run(0);
+  }
+  for (size_t worker = 0; worker < workers; ++worker) {
+    if (errors[worker]) {
+      std::rethrow_exception(errors[worker]);
+    }
+  }
+}
+
+struct ModuloBuckets {};
+
+struct PowerOfTwoBuckets {};
+
+// std::hash of an integer is the identity, so the bucket is taken from a
+// mixed hash or keys that share their low bits would share a bucket. the
+// multiply spreads every bit upwards and the fold brings the high half back
+// down, which also keeps the low bits apart from the top bits the concurrent
+// map picks its shard with
+inline uint64_t mix_bucket_hash(uint64_t hash) noexcept {
+  hash *= 0x9E3779B97F4A7C15ULL;
+  return hash ^ (hash >> 32);
+}
+
+template <typename Hash, typename Equal, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename Hash, typename Equal>
+struct IsTransparent<Hash, Equal,
+                     std::void_t<typename Hash::is_transparent,
+                                 typename Equal::is_transparent>>
+    : std::true_type {};
+
+template <typename Key, typename... Args>
+struct IsKeyValueArgs : std::false_type {};
+
+template <typename Key, typename First, typename Second>
+struct IsKeyValueArgs<Key, First, Second>
+    : std::is_same<std::remove_cvref_t<First>, Key> {};
+
+// a read-only view of a map snapshot, meant for a file mapped with mmap;
+// the layout is a header, bucket_count + 1 record offsets and the records
+// grouped by bucket, so it only holds offsets and is usable at any address;
+// the hashes are those of the writing process, Hash has to reproduce them
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+class MappedUnorderedMap {
+ public:
+  struct Record {
+    uint64_t hash;
+    Key key;
+    Value value;
+  };
+
+  // bytes must stay alive and aligned for Record, a mapping always is
+  explicit MappedUnorderedMap(std::span<const std::byte> bytes,
+                              Hash hash = Hash(), Equal equal = Equal());
+
+  inline size_t size() const noexcept {
+    return records_.size();
+  }
+
+  inline bool empty() const noexcept {
+    return records_.empty();
+  }
+
+  inline size_t bucket_count() const noexcept {
+    return starts_.size() - 1;
+  }
+
+  inline std::span<const Record> records() const noexcept {
+    return records_;
+  }
+
+  inline Hash hash_function() const {
+    return hash_;
+  }
+
+  inline Equal key_eq() const {
+    return equal_;
+  }
+
+  // null when the key is missing
+  const Record* find(const Key& key) const;
+
+  inline bool contains(const Key& key) const {
+    return find(key) != nullptr;
+  }
+
+  const Value& at(const Key& key) const {
+    const Record* record = find(key);
+    if (record == nullptr) {
+      throw std::out_of_range("no such element");
+    }
+    return record->value;
+  }
+
+  const Value& operator[](const Key& key) const {
+    return at(key);
+  }
+
+  // lays the records out by bucket and writes the snapshot with one call,
+  // keys must be unique
+  static void write(std::ostream& out, std::span<const Record> records);
+
+ private:
+  struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t bucket_count;
+  };
+
+  // "umapsnap", read back in the wrong byte order it does not match
+  constexpr static uint64_t magic = 0x70616e7370616d75;
+  constexpr static uint32_t version = 2;
+
+  inline static size_t records_offset(size_t bucket_count) noexcept {
+    size_t offset = sizeof(Header) + (bucket_count + 1) * sizeof(uint64_t);
+    return (offset + alignof(Record) - 1) / alignof(Record) * alignof(Record);
+  }
+
+  std::span<const uint64_t> starts_;
+  std::span<const Record> records_;
+  [[no_unique_address]] Hash hash_;
+  [[no_unique_address]] Equal equal_;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+MappedUnorderedMap<Key, Value, Hash, Equal>::MappedUnorderedMap(
+    std::span<const std::byte> bytes, Hash hash, Equal equal)
+    : hash_(std::move(hash)),
+      equal_(std::move(equal)) {
+  static_assert(std::is_trivially_copyable_v<Key> &&
+                    std::is_trivially_copyable_v<Value>,
+                "snapshots hold trivially copyable keys and values only");
+  Header header;
+  if (bytes.size() < sizeof(Header)) {
+    throw std::invalid_argument("truncated snapshot");
+  }
+  std::memcpy(&header, bytes.data(), sizeof(Header));
+  if (header.magic != magic || header.version != version ||
+      header.record_size != sizeof(Record) || header.bucket_count == 0) {
+    throw std::invalid_argument("not a snapshot of this map type");
+  }
+  size_t offset = records_offset(header.bucket_count);
+  if (bytes.size() < offset ||
+      (bytes.size() - offset) / sizeof(Record) < header.count) {
+    throw std::invalid_argument("truncated snapshot");
+  }
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(Record) != 0) {
+    throw std::invalid_argument("misaligned snapshot");
+  }
+  starts_ = {reinterpret_cast<const uint64_t*>(bytes.data() + sizeof(Header)),
+             header.bucket_count + 1};
+  records_ = {reinterpret_cast<const Record*>(bytes.data() + offset),
+              header.count};
+  if (starts_.back() != header.count) {
+    throw std::invalid_argument("corrupted snapshot");
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+auto MappedUnorderedMap<Key, Value, Hash, Equal>::find(const Key& key) const
+    -> const Record* {
+  uint64_t hash = hash_(key);
+  size_t bucket = mix_bucket_hash(hash) % bucket_count();
+  // a broken offset only shortens the walk, it never leaves records_
+  size_t last = std::min<size_t>(starts_[bucket + 1], size());
+  for (size_t i = starts_[bucket]; i < last; ++i) {
+    if (records_[i].hash == hash && equal_(records_[i].key, key)) {
+      return &records_[i];
+    }
+  }
+  return nullptr;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+void MappedUnorderedMap<Key, Value, Hash, Equal>::write(
+    std::ostream& out, std::span<const Record> records) {
+  static_assert(std::is_trivially_copyable_v<Key> &&
+                    std::is_trivially_copyable_v<Value>,
+                "snapshots hold trivially copyable keys and values only");
+  Header header{magic, version, sizeof(Record), records.size(),
+                std::max<uint64_t>(records.size(), 1)};
+  size_t offset = records_offset(header.bucket_count);
+  // zeroed, so padding bytes are written deterministically
+  std::vector<std::byte> bytes(offset + records.size() * sizeof(Record));
+  std::vector<uint64_t> starts(header.bucket_count + 1);
+  for (const Record& record : records) {
+    ++starts[mix_bucket_hash(record.hash) % header.bucket_count + 1];
+  }
+  std::partial_sum(starts.begin(), starts.end(), starts.begin());
+  std::memcpy(bytes.data(), &header, sizeof(Header));
+  std::memcpy(bytes.data() + sizeof(Header), starts.data(),
+              starts.size() * sizeof(uint64_t));
+  for (const Record& record : records) {
+    std::memcpy(bytes.data() + offset +
+                    starts[mix_bucket_hash(record.hash) %
+                           header.bucket_count]++ *
+                        sizeof(Record),
+                &record, sizeof(Record));
+  }
+  out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+// filled only by maps built with CollectStats, lookups count the entries
+// compared on the way, the last bin collects every longer walk
+struct UnorderedMapStats {
+  constexpr static size_t histogram_size = 16;
+
+  size_t lookups = 0;
+  std::array<size_t, histogram_size> chain_lengths{};
+  size_t rehashes = 0;
+  size_t migration_steps = 0;
+  std::chrono::nanoseconds rehash_time{0};
+};
+
 template <typename Key, typename Value, typename Hash = std::hash<Key>,
           typename Equal = std::equal_to<Key>,
-          typename Alloc = std::allocator<std::pair<const Key, Value>>>
+          typename Alloc = std::allocator<std::pair<const Key, Value>>,
+          typename BucketPolicy = ModuloBuckets, bool CollectStats = false>
 class UnorderedMap {
  public:
   using NodeType = std::pair<const Key, Value>;
@@ -399,25 +967,46 @@ class UnorderedMap {
  private:
   // struct Handler;
 
+  struct Entry;
+
   template <bool is_const>
   struct Iterator;
 
+  using EntryAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Entry>;
+  using ListType = List<Entry, EntryAlloc>;
+
  public:
   using iterator = Iterator<false>;
   using const_iterator = Iterator<true>;
 
+ private:
+  // heterogeneous overloads are enabled only when both Hash and Equal are
+  // transparent, plain Key arguments keep using the regular overloads
+  template <typename K>
+  using EnableTransparent =
+      std::enable_if_t<IsTransparent<Hash, Equal>::value &&
+                           !std::is_same_v<std::remove_cvref_t<K>, Key>,
+                       bool>;
+
+ public:
   UnorderedMap(Alloc alloc = Alloc())
       : max_factor_(default_factor),
-        values_(alloc) {
+        values_(EntryAlloc(alloc)) {
   }
 
-  UnorderedMap(const UnorderedMap&) = default;
+  UnorderedMap(const UnorderedMap& map);
 
-  UnorderedMap(UnorderedMap&& map);
+  UnorderedMap(UnorderedMap&& map) noexcept;
+
+  // the stored hashes are reused, so Hash is not called
+  explicit UnorderedMap(
+      const MappedUnorderedMap<Key, Value, Hash, Equal>& snapshot,
+      Alloc alloc = Alloc());
 
   UnorderedMap& operator=(UnorderedMap&& map);
 
-  UnorderedMap& operator=(const UnorderedMap&) = default;
+  UnorderedMap& operator=(const UnorderedMap& map);
 
   ~UnorderedMap() = default;
 
@@ -445,6 +1034,20 @@ class UnorderedMap {
     max_factor_ = new_factor;
   }
 
+  inline bool incremental_rehash() const noexcept {
+    return incremental_;
+  }
+
+  // in incremental mode growing keeps the old bucket array alive and every
+  // insert moves a few of its buckets over, lookups check both arrays until
+  // the migration is done; rehash and reserve always rebuild at once
+  void incremental_rehash(bool enable) {
+    incremental_ = enable;
+    if (!enable) {
+      finish_migration();
+    }
+  }
+
   inline iterator begin() noexcept {
     return values_.begin();
   }
@@ -469,14 +1072,22 @@ class UnorderedMap {
     return values_.end();
   }
 
-  Value& at(const Key& key);
+  Value& at(const Key& key) {
+    return at_impl(key);
+  }
 
-  Value at(const Key& key) const {
-    const_iterator result = find(key);
-    if (result == cend()) {
-      throw std::out_of_range("no such element");
-    }
-    return *result;
+  const Value& at(const Key& key) const {
+    return const_cast<UnorderedMap*>(this)->at_impl(key);
+  }
+
+  template <typename K, EnableTransparent<K> = true>
+  Value& at(const K& key) {
+    return at_impl(key);
+  }
+
+  template <typename K, EnableTransparent<K> = true>
+  const Value& at(const K& key) const {
+    return const_cast<UnorderedMap*>(this)->at_impl(key);
   }
 
   void rehash(size_t count);
@@ -485,211 +1096,1051 @@ class UnorderedMap {
     rehash(std::ceil(count / max_load_factor()));
   }
 
+  // rehash splitting the bucket indices, the grouping by bucket and the
+  // relinking between up to threads workers (0 means one per core); only
+  // the hashes kept in the nodes are read
+  void rehash_parallel(size_t count, size_t threads = 0);
+
   template <typename... Args>
   std::pair<iterator, bool> emplace(Args&&... args);
 
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+    return try_emplace_impl(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args) {
+    return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const Key& key, M&& value) {
+    return insert_or_assign_impl(key, std::forward<M>(value));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(Key&& key, M&& value) {
+    return insert_or_assign_impl(std::move(key), std::forward<M>(value));
+  }
+
   std::pair<iterator, bool> insert(const NodeType& node) {
-    return emplace(node.first, node.second);
+    return try_emplace(node.first, node.second);
   }
 
   std::pair<iterator, bool> insert(NodeType&& node) {
-    return emplace(const_cast<Key&&>(std::move(node.first)),
-                   std::move(node.second));
+    return try_emplace(const_cast<Key&&>(std::move(node.first)),
+                       std::move(node.second));
   }
 
   template <typename InputIt>
   void insert(InputIt begin, InputIt end);
 
-  const_iterator find(const Key& key) const;
+  const_iterator find(const Key& key) const {
+    return const_cast<UnorderedMap*>(this)->find(key);
+  }
 
-  iterator find(const Key& key);
+  iterator find(const Key& key) {
+    return find_hashed(key, hash_(key));
+  }
 
-  bool empty() const noexcept {
-    return size() == 0;
+  template <typename K, EnableTransparent<K> = true>
+  const_iterator find(const K& key) const {
+    return const_cast<UnorderedMap*>(this)->find(key);
   }
 
-  Value& operator[](const Key& key);
+  template <typename K, EnableTransparent<K> = true>
+  iterator find(const K& key) {
+    return find_hashed(key, hash_(key));
+  }
 
-  Value& operator[](Key&& key) {
-    return (*emplace(std::move(key), Value()).first).second;
+  // writes one iterator per key to out; keys go in groups, and while one
+  // group is resolved the head nodes of the next one and the bucket slots
+  // of the one after are prefetched. pays off once the table outgrows the
+  // cache, below that a loop of find() is faster
+  template <typename OutputIt>
+  OutputIt find_batch(std::span<const Key> keys, OutputIt out) {
+    return find_batch_impl<iterator>(keys, out);
   }
 
-  iterator erase(const_iterator iter);
+  template <typename OutputIt>
+  OutputIt find_batch(std::span<const Key> keys, OutputIt out) const {
+    return const_cast<UnorderedMap*>(this)->template find_batch_impl<
+        const_iterator>(keys, out);
+  }
 
-  iterator erase(const_iterator first, const_iterator second);
+  // returns the number of inserted nodes
+  size_t insert_batch(std::span<const NodeType> nodes);
 
- private:
-  inline const_iterator get_iter(const Key& key) const {
-    return buckets_[get_hash(key)];
+  // bulk insert for large ranges: buckets are sized once, keys are hashed
+  // and grouped and nodes linked by up to threads workers, with a stateless
+  // allocator the nodes are built by the workers too; Hash and Equal are
+  // called concurrently; of equal keys the present or first one is kept,
+  // as with insert, and the number of inserted nodes is returned
+  size_t insert_parallel(std::span<const NodeType> nodes, size_t threads = 0);
+
+  bool empty() const noexcept {
+    return size() == 0;
   }
 
-  inline iterator get_iter(const Key& key) {
-    return buckets_[get_hash(key)];
+  Value& operator[](const Key& key) {
+    return try_emplace_impl(key).first->second;
   }
 
-  inline size_t get_hash(const Key& key) const {
-    return hash_(key) % bucket_count();
+  Value& operator[](Key&& key) {
+    return try_emplace_impl(std::move(key)).first->second;
+  }
+
+  template <typename K, EnableTransparent<K> = true>
+  Value& operator[](K&& key) {
+    return try_emplace_impl(std::forward<K>(key)).first->second;
+  }
+
+  iterator erase(const_iterator iter);
+
+  iterator erase(const_iterator first, const_iterator second);
+
+  class NodeHandle;
+
+  struct InsertResult;
+
+  // extract and node insertion relink the entry, its value is neither
+  // moved nor copied; allocators of both maps must compare equal
+  NodeHandle extract(const_iterator iter) noexcept;
+
+  NodeHandle extract(const Key& key);
+
+  InsertResult insert(NodeHandle&& node);
+
+  // writes the layout read by MappedUnorderedMap, Key and Value have to be
+  // trivially copyable
+  void write_snapshot(std::ostream& out) const;
+
+  // counters describe work done by this object, copies and moves never
+  // carry them over
+  UnorderedMapStats stats() const noexcept
+    requires CollectStats
+  {
+    return stats_;
+  }
+
+  void reset_stats() noexcept
+    requires CollectStats
+  {
+    stats_ = UnorderedMapStats();
+  }
+
+ private:
+  template <typename, typename, typename, typename, typename, typename,
+            size_t>
+  friend class ConcurrentUnorderedMap;
+
+  struct NoStats {};
+
+  using Stats = std::conditional_t<CollectStats, UnorderedMapStats, NoStats>;
+
+  // adds the lifetime of the scope to rehash_time
+  class RehashTimer {
+   public:
+    explicit RehashTimer(Stats& stats) noexcept : stats_(stats) {
+      if constexpr (CollectStats) {
+        ++stats_.rehashes;
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    ~RehashTimer() {
+      if constexpr (CollectStats) {
+        stats_.rehash_time += std::chrono::steady_clock::now() - start_;
+      }
+    }
+
+   private:
+    Stats& stats_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  inline void record_lookup([[maybe_unused]] size_t length) noexcept {
+    if constexpr (CollectStats) {
+      ++stats_.lookups;
+      ++stats_.chain_lengths[std::min(length,
+                                      UnorderedMapStats::histogram_size - 1)];
+    }
   }
 
-  inline bool equal(const Key& first, const Key& second) const {
+  using ListIterator = typename ListType::iterator;
+  using EntryTraits = std::allocator_traits<EntryAlloc>;
+
+  // empty buckets hold a null iterator rather than values_.end(), so moving
+  // the node chain to another map keeps every bucket valid
+  inline static ListIterator null_bucket() noexcept {
+    return ListIterator(nullptr);
+  }
+
+  inline static size_t bucket_index(size_t hash, size_t count) noexcept {
+    if constexpr (std::is_same_v<BucketPolicy, PowerOfTwoBuckets>) {
+      return mix_bucket_hash(hash) & (count - 1);
+    } else {
+      return hash % count;
+    }
+  }
+
+  inline size_t bucket_index(size_t hash) const noexcept {
+    return bucket_index(hash, bucket_count());
+  }
+
+  // buckets of the old array below migrated_ have already been moved
+  inline bool in_old_buckets(size_t hash) const noexcept {
+    return !old_buckets_.empty() &&
+           bucket_index(hash, old_buckets_.size()) >= migrated_;
+  }
+
+  inline ListIterator& bucket_of(size_t hash) noexcept {
+    if (in_old_buckets(hash)) {
+      return old_buckets_[bucket_index(hash, old_buckets_.size())];
+    }
+    return buckets_[bucket_index(hash)];
+  }
+
+  inline bool same_bucket(size_t first, size_t second) const noexcept {
+    bool old = in_old_buckets(first);
+    size_t count = old ? old_buckets_.size() : bucket_count();
+    return old == in_old_buckets(second) &&
+           bucket_index(first, count) == bucket_index(second, count);
+  }
+
+  size_t fit_bucket_count(size_t count) const noexcept;
+
+  template <typename T, typename Projection, typename Resolve>
+  void pipeline_batch(std::span<T> items, Projection key, Resolve resolve);
+
+  template <typename IteratorType, typename OutputIt>
+  OutputIt find_batch_impl(std::span<const Key> keys, OutputIt out);
+
+  template <typename K>
+  inline bool equal(const Key& first, const K& second) const {
     return equal_(first, second);
   }
 
+  template <typename K>
+  ListIterator find_hashed(const K& key, size_t hash);
+
+  template <typename K>
+  Value& at_impl(const K& key);
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace_impl(K&& key, Args&&... args) {
+    size_t hash = hash_(key);
+    return try_emplace_hashed(hash, std::forward<K>(key),
+                              std::forward<Args>(args)...);
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace_hashed(size_t hash, K&& key,
+                                               Args&&... args);
+
+  template <typename K, typename M>
+  std::pair<iterator, bool> insert_or_assign_impl(K&& key, M&& value);
+
+  void grow_if_needed();
+
+  void start_migration(size_t count);
+
+  void migrate(size_t count) noexcept;
+
+  inline void finish_migration() noexcept {
+    migrate(old_buckets_.size());
+  }
+
+  template <typename... Args>
+  ListIterator emplace_hashed(size_t hash, Args&&... args);
+
+  void rebuild_buckets(size_t count, size_t old_count = 0);
+
+  inline static size_t worker_count(size_t count, size_t threads) noexcept {
+    if (threads == 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+    threads = std::clamp<size_t>(threads, 1, max_parallel_workers);
+    return std::clamp<size_t>(count / parallel_grain, 1, threads);
+  }
+
+  // regroups every node by bucket into a fresh array of count buckets;
+  // nodes are built for the values of fresh whose key is not present yet
+  void parallel_relink(size_t count, size_t workers,
+                       std::span<const NodeType> fresh = {},
+                       std::span<const size_t> fresh_hashes = {});
+
+  // moves the bucket head off iter before its node leaves the list
+  void unlink_bucket(ListIterator iter) noexcept;
+
   double max_factor_;
   constexpr static double default_factor = 0.75;
   constexpr static double growing_coefficient = 2;
   constexpr static size_t default_start_size = 16;
+  constexpr static size_t migration_step = 4;
+  constexpr static size_t batch_size = 16;
+  constexpr static size_t parallel_grain = 1 << 14;
   [[no_unique_address]] Hash hash_;
   [[no_unique_address]] Equal equal_;
-  List<NodeType, Alloc> values_;
-  std::vector<typename List<NodeType, Alloc>::iterator> buckets_;
+  ListType values_;
+  std::vector<ListIterator> buckets_;
+  std::vector<ListIterator> old_buckets_;
+  size_t migrated_ = 0;
+  bool incremental_ = false;
+  [[no_unique_address]] mutable Stats stats_;
 };
 
+// the full hash is kept next to the value so that bucket walks and rehashes
+// never have to call Hash again
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-Value& UnorderedMap<Key, Value, Hash, Equal, Alloc>::at(const Key& key) {
-  iterator result = find(key);
-  if (result == end()) {
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+struct UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::Entry {
+  template <typename... Args>
+  Entry(size_t hash, Args&&... args)
+      : value(std::forward<Args>(args)...),
+        hash(hash) {
+  }
+
+  NodeType value;
+  size_t hash;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                   BucketPolicy, CollectStats>::NodeHandle {
+ public:
+  NodeHandle() noexcept = default;
+
+  bool empty() const noexcept {
+    return handle_.empty();
+  }
+
+  explicit operator bool() const noexcept {
+    return !empty();
+  }
+
+  // the key may be changed while the node is outside of any map
+  Key& key() const noexcept {
+    return const_cast<Key&>(handle_.value().value.first);
+  }
+
+  Value& mapped() const noexcept {
+    return handle_.value().value.second;
+  }
+
+  Alloc get_allocator() const {
+    return Alloc(handle_.get_allocator());
+  }
+
+ private:
+  friend UnorderedMap;
+
+  explicit NodeHandle(typename ListType::NodeHandle handle) noexcept
+      : handle_(std::move(handle)) {
+  }
+
+  typename ListType::NodeHandle handle_;
+};
+
+// node is empty unless insertion failed, then it still owns the entry
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+struct UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::InsertResult {
+  iterator position;
+  bool inserted;
+  NodeHandle node;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::UnorderedMap(const UnorderedMap& map)
+    : max_factor_(map.max_factor_),
+      hash_(map.hash_),
+      equal_(map.equal_),
+      values_(map.values_),
+      migrated_(map.migrated_),
+      incremental_(map.incremental_) {
+  rebuild_buckets(map.bucket_count(), map.old_buckets_.size());
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::UnorderedMap(
+    const MappedUnorderedMap<Key, Value, Hash, Equal>& snapshot, Alloc alloc)
+    : max_factor_(default_factor),
+      hash_(snapshot.hash_function()),
+      equal_(snapshot.key_eq()),
+      values_(EntryAlloc(alloc)) {
+  reserve(snapshot.size());
+  for (const auto& record : snapshot.records()) {
+    emplace_hashed(record.hash, record.key, record.value);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::write_snapshot(
+    std::ostream& out) const {
+  using Snapshot = MappedUnorderedMap<Key, Value, Hash, Equal>;
+  std::vector<typename Snapshot::Record> records;
+  records.reserve(size());
+  for (const Entry& entry : values_) {
+    records.push_back({entry.hash, entry.value.first, entry.value.second});
+  }
+  Snapshot::write(out, records);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy, CollectStats>&
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::operator=(
+    const UnorderedMap& map) {
+  if (this != &map) {
+    UnorderedMap copy = map;
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename K>
+Value& UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::at_impl(const K& key) {
+  ListIterator result = find_hashed(key, hash_(key));
+  if (result == values_.end()) {
     throw std::out_of_range("no such element");
   }
-  return result->second;
+  return result->value.second;
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::rehash(size_t count) {
-  count = std::max(count, static_cast<size_t>(size() / max_load_factor()));
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::rehash(size_t count) {
+  finish_migration();
+  count = fit_bucket_count(count);
+  if (count == bucket_count()) {
+    return;
+  }
+  RehashTimer timer(stats_);
+  // relinking only moves nodes in front of the unvisited tail of the list
+  buckets_.assign(count, null_bucket());
+  for (ListIterator iter = values_.begin(); iter != values_.end();) {
+    ListIterator next = iter;
+    ++next;
+    ListIterator& bucket = buckets_[bucket_index(iter->hash)];
+    values_.splice(bucket == null_bucket() ? values_.begin() : bucket,
+                   values_, iter);
+    bucket = iter;
+    iter = next;
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::rehash_parallel(size_t count,
+                                                               size_t threads) {
+  finish_migration();
+  count = fit_bucket_count(count);
   if (count == bucket_count()) {
     return;
   }
-  List<NodeType, Alloc> copy(values_.get_allocator());
-  while (!values_.is_empty()) {
-    auto& item = *values_.begin();
-    copy.emplace_back(const_cast<Key&&>(std::move(item.first)),
-                      std::move(item.second));
-    values_.pop_front();
+  if (empty()) {
+    buckets_.assign(count, null_bucket());
+    return;
+  }
+  RehashTimer timer(stats_);
+  parallel_relink(count, worker_count(size(), threads));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::insert_parallel(
+    std::span<const NodeType> nodes, size_t threads) {
+  if (nodes.empty()) {
+    return 0;
+  }
+  finish_migration();
+  size_t workers = worker_count(nodes.size(), threads);
+  std::vector<size_t> hashes(nodes.size());
+  run_parallel(nodes.size(), workers, [&](size_t, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      hashes[i] = hash_(nodes[i].first);
+    }
+  });
+  size_t old_size = size();
+  size_t count = std::max(
+      bucket_count(),
+      fit_bucket_count(std::ceil((size() + nodes.size()) / max_load_factor())));
+  RehashTimer timer(stats_);
+  parallel_relink(count, workers, nodes, hashes);
+  return size() - old_size;
+}
+
+// items are the present nodes followed by fresh; workers scatter their
+// ranges of items to per-worker partitions of the buckets, then every
+// partition is counting sorted by bucket on its own; both passes are stable,
+// so the present nodes and earlier fresh items come first in a bucket and
+// later equal keys are dropped before any node is built for them; the map
+// is only changed once nothing can throw any more
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::parallel_relink(
+    size_t count, size_t workers, std::span<const NodeType> fresh,
+    std::span<const size_t> fresh_hashes) {
+  std::vector<ListIterator> nodes;
+  nodes.reserve(size());
+  for (ListIterator iter = values_.begin(); iter != values_.end(); ++iter) {
+    nodes.push_back(iter);
+  }
+  size_t present = nodes.size();
+  size_t items = present + fresh.size();
+  auto key_of = [&](size_t item) -> const Key& {
+    return item < present ? nodes[item]->value.first
+                          : fresh[item - present].first;
+  };
+  // partition part holds buckets [first_bucket(part), first_bucket(part + 1))
+  auto partition_of = [&](size_t bucket) {
+    return bucket * workers / count;
+  };
+  auto first_bucket = [&](size_t part) {
+    return (part * count + workers - 1) / workers;
+  };
+  // hashes are copied out so that the later passes mostly stay off the nodes
+  std::vector<size_t> hash(items);
+  std::vector<size_t> bucket(items);
+  std::vector<size_t> offsets(workers * workers);
+  run_parallel(items, workers, [&](size_t worker, size_t first, size_t last) {
+    size_t* counts = offsets.data() + worker * workers;
+    for (size_t i = first; i < last; ++i) {
+      hash[i] = i < present ? nodes[i]->hash : fresh_hashes[i - present];
+      bucket[i] = bucket_index(hash[i], count);
+      ++counts[partition_of(bucket[i])];
+    }
+  });
+  std::vector<size_t> starts(workers + 1, items);
+  for (size_t part = 0, position = 0; part < workers; ++part) {
+    starts[part] = position;
+    for (size_t worker = 0; worker < workers; ++worker) {
+      position += std::exchange(offsets[worker * workers + part], position);
+    }
+  }
+  std::vector<size_t> grouped(items);
+  run_parallel(items, workers, [&](size_t worker, size_t first, size_t last) {
+    size_t* next = offsets.data() + worker * workers;
+    for (size_t i = first; i < last; ++i) {
+      grouped[next[partition_of(bucket[i])]++] = i;
+    }
+  });
+  std::vector<size_t> sorted(items);
+  std::vector<size_t> kept(workers);
+  run_parallel(workers, workers, [&](size_t part, size_t, size_t) {
+    size_t low = first_bucket(part);
+    size_t begin = starts[part];
+    size_t end = starts[part + 1];
+    std::vector<size_t> heads(first_bucket(part + 1) - low + 1);
+    for (size_t i = begin; i < end; ++i) {
+      ++heads[bucket[grouped[i]] - low + 1];
+    }
+    std::partial_sum(heads.begin(), heads.end(), heads.begin());
+    for (size_t i = begin; i < end; ++i) {
+      sorted[begin + heads[bucket[grouped[i]] - low]++] = grouped[i];
+    }
+    // kept items are compacted to the front of the partition
+    size_t out = begin;
+    for (size_t run = begin; run < end;) {
+      size_t index = bucket[sorted[run]];
+      size_t run_out = out;
+      for (; run < end && bucket[sorted[run]] == index; ++run) {
+        size_t item = sorted[run];
+        bool seen = false;
+        for (size_t i = run_out; item >= present && !seen && i < out; ++i) {
+          seen = hash[sorted[i]] == hash[item] &&
+                 equal(key_of(sorted[i]), key_of(item));
+        }
+        if (!seen) {
+          sorted[out++] = item;
+        }
+      }
+    }
+    kept[part] = out - begin;
+  });
+  std::vector<size_t> kept_starts(workers + 1);
+  std::partial_sum(kept.begin(), kept.end(), kept_starts.begin() + 1);
+  std::vector<ListIterator> order(kept_starts.back(), null_bucket());
+  std::vector<ListIterator> buckets(count, null_bucket());
+  std::vector<ListType> runs;
+  runs.reserve(workers);
+  for (size_t part = 0; part < workers; ++part) {
+    runs.emplace_back(values_.get_allocator());
+  }
+  // a stateless allocator is taken to be safe to call from any thread,
+  // any other one builds the fresh nodes on the calling thread
+  size_t builders = EntryTraits::is_always_equal::value ? workers : 1;
+  run_parallel(workers, builders, [&](size_t, size_t first, size_t last) {
+    for (size_t part = first; part < last; ++part) {
+      for (size_t i = 0; i < kept[part]; ++i) {
+        size_t item = sorted[starts[part] + i];
+        ListIterator& node = order[kept_starts[part] + i];
+        if (item < present) {
+          node = nodes[item];
+        } else {
+          runs[part].emplace_back(hash[item], fresh[item - present]);
+          node = --runs[part].end();
+        }
+        ListIterator& head = buckets[bucket[item]];
+        if (head == null_bucket()) {
+          head = node;
+        }
+      }
+    }
+  });
+  for (ListType& run : runs) {
+    values_.splice(values_.end(), run);
+  }
+  run_parallel(order.size(), workers,
+               [&](size_t, size_t first, size_t last) noexcept {
+                 values_.relink(order, first, last);
+               });
+  buckets_ = std::move(buckets);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::rebuild_buckets(
+    size_t count, size_t old_count) {
+  buckets_.assign(count, null_bucket());
+  old_buckets_.assign(old_count, null_bucket());
+  for (auto it = values_.begin(); it != values_.end(); ++it) {
+    auto& bucket = bucket_of(it->hash);
+    if (bucket == null_bucket()) {
+      bucket = it;
+    }
+  }
+}
+
+// a bucket slot is only read a group after its prefetch, when it is likely
+// in cache, and the node it points to is read another group later. the
+// slots are found once; a group whose buckets were rebuilt in between, by
+// an insert, finds them again
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename T, typename Projection, typename Resolve>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::pipeline_batch(
+    std::span<T> items, Projection key, Resolve resolve) {
+  constexpr size_t stages = 3;
+  struct Stage {
+    size_t hashes[batch_size];
+    ListIterator* slots[batch_size];
+    const ListIterator* buckets;
+    const ListIterator* old_buckets;
+    size_t migrated;
+  };
+  Stage pipeline[stages];
+  size_t groups = (items.size() + batch_size - 1) / batch_size;
+  auto group = [&](size_t index) {
+    size_t first = index * batch_size;
+    return items.subspan(first, std::min(batch_size, items.size() - first));
+  };
+  auto prefetch_buckets = [&](size_t index) {
+    auto part = group(index);
+    Stage& stage = pipeline[index % stages];
+    for (size_t i = 0; i < part.size(); ++i) {
+      stage.hashes[i] = hash_(key(part[i]));
+    }
+    stage.buckets = buckets_.data();
+    stage.old_buckets = old_buckets_.data();
+    stage.migrated = migrated_;
+    if (bucket_count() == 0) {
+      return;
+    }
+    for (size_t i = 0; i < part.size(); ++i) {
+      stage.slots[i] = &bucket_of(stage.hashes[i]);
+      prefetch(stage.slots[i]);
+    }
+  };
+  auto prefetch_nodes = [&](size_t index) {
+    if (bucket_count() == 0) {
+      return;
+    }
+    Stage& stage = pipeline[index % stages];
+    size_t count = group(index).size();
+    if (stage.buckets != buckets_.data() ||
+        stage.old_buckets != old_buckets_.data() ||
+        stage.migrated != migrated_) {
+      for (size_t i = 0; i < count; ++i) {
+        stage.slots[i] = &bucket_of(stage.hashes[i]);
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      prefetch(stage.slots[i]->node);
+    }
+  };
+  for (size_t index = 0; index < std::min(groups, stages - 1); ++index) {
+    prefetch_buckets(index);
   }
-  buckets_.assign(count, values_.end());
-  while (!copy.is_empty()) {
-    auto&& item = *copy.begin();
-    insert(std::move(item));
-    copy.pop_front();
+  if (groups != 0) {
+    prefetch_nodes(0);
   }
+  for (size_t index = 0; index < groups; ++index) {
+    if (index + 2 < groups) {
+      prefetch_buckets(index + 2);
+    }
+    if (index + 1 < groups) {
+      prefetch_nodes(index + 1);
+    }
+    auto part = group(index);
+    const size_t* hashes = pipeline[index % stages].hashes;
+    for (size_t i = 0; i < part.size(); ++i) {
+      resolve(part[i], hashes[i]);
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename IteratorType, typename OutputIt>
+OutputIt
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::find_batch_impl(
+    std::span<const Key> keys, OutputIt out) {
+  pipeline_batch(
+      keys, [](const Key& key) -> const Key& { return key; },
+      [&](const Key& key, size_t hash) {
+        *out = IteratorType(iterator(find_hashed(key, hash)));
+        ++out;
+      });
+  return out;
+}
+
+// grows once up front unless that would break the incremental mode promise
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::insert_batch(
+    std::span<const NodeType> nodes) {
+  if (!incremental_ && size() + nodes.size() >
+                           static_cast<size_t>(bucket_count() *
+                                               max_load_factor())) {
+    reserve(size() + nodes.size());
+  }
+  size_t inserted = 0;
+  pipeline_batch(
+      nodes, [](const NodeType& node) -> const Key& { return node.first; },
+      [&](const NodeType& node, size_t hash) {
+        inserted += try_emplace_hashed(hash, node.first, node.second).second;
+      });
+  return inserted;
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
+          typename Alloc, typename BucketPolicy, bool CollectStats>
 template <typename InputIt>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::insert(InputIt begin,
-                                                          InputIt end) {
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::insert(
+    InputIt begin, InputIt end) {
   for (auto it = begin; it != end; ++it) {
     insert(*it);
   }
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::const_iterator
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) const {
-  auto hash = get_hash(key);
-  const_iterator begin = get_iter(key);
-  const_iterator end = (hash != buckets_.size() - 1)
-                           ? const_iterator(buckets_[hash + 1])
-                           : cend();
-  for (; begin != end; ++begin) {
-    if (equal(begin->first, key)) {
-      return begin;
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename K>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::ListIterator
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::find_hashed(
+    const K& key, size_t hash) {
+  if (empty()) {
+    return values_.end();
+  }
+  ListIterator bucket = bucket_of(hash);
+  if (bucket == null_bucket()) {
+    record_lookup(0);
+    return values_.end();
+  }
+  size_t length = 0;
+  for (ListIterator bucket_begin = bucket;
+       bucket_begin != values_.end() && same_bucket(bucket_begin->hash, hash);
+       ++bucket_begin) {
+    ++length;
+    if (bucket_begin->hash == hash && equal(bucket_begin->value.first, key)) {
+      record_lookup(length);
+      return bucket_begin;
     }
   }
-  return cend();
+  record_lookup(length);
+  return values_.end();
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
+          typename Alloc, typename BucketPolicy, bool CollectStats>
 template <typename... Args>
-std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator, bool>
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::emplace(Args&&... args) {
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::ListIterator
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::emplace_hashed(
+    size_t hash, Args&&... args) {
+  ListIterator& bucket = bucket_of(hash);
+  if (bucket == null_bucket()) {
+    values_.emplace_front(hash, std::forward<Args>(args)...);
+    bucket = values_.begin();
+  } else {
+    values_.emplace(bucket, hash, std::forward<Args>(args)...);
+    --bucket;
+  }
+  return bucket;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::grow_if_needed() {
+  migrate(migration_step);
   if (size() + 1 > static_cast<size_t>(bucket_count() * max_load_factor())) {
-    reserve(std::max(default_start_size, static_cast<size_t>(std::ceil(
-                                             growing_coefficient * size()))));
-  }
-  std::pair<Key, Value>* node =
-      values_.template construct_with_allocator<std::pair<Key, Value>>(
-          std::forward<Args>(args)...);
-  iterator iter = find(node->first);
-  if (iter != end()) {
-    values_.destroy_with_allocator(node);
-    return {iter, false};
+    size_t count = std::max(default_start_size,
+                            static_cast<size_t>(
+                                std::ceil(growing_coefficient * size())));
+    if (incremental_) {
+      start_migration(std::ceil(count / max_load_factor()));
+    } else {
+      reserve(count);
+    }
   }
-  iter = get_iter(node->first);
-  auto hash = get_hash(node->first);
-  if (iter == end()) {
-    values_.emplace_front(std::move(node->first), std::move(node->second));
-    buckets_[hash] = values_.begin();
-    values_.destroy_with_allocator(node);
-    return {begin(), true};
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::fit_bucket_count(
+    size_t count) const noexcept {
+  count = std::max(count, static_cast<size_t>(size() / max_load_factor()));
+  if constexpr (std::is_same_v<BucketPolicy, PowerOfTwoBuckets>) {
+    count = std::bit_ceil(count);
   }
-  values_.emplace(iter.node, std::move(node->first), std::move(node->second));
-  --buckets_[hash];
-  values_.destroy_with_allocator(node);
-  return {buckets_[hash], true};
+  return count;
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::find(const Key& key) {
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::start_migration(size_t count) {
+  finish_migration();
+  count = fit_bucket_count(count);
+  if (count == bucket_count()) {
+    return;
+  }
   if (empty()) {
-    return end();
+    buckets_.assign(count, null_bucket());
+    return;
   }
-  auto hash = get_hash(key);
-  for (iterator bucket_begin = get_iter(key);
-       bucket_begin != values_.end() && get_hash(bucket_begin->first) == hash;
-       ++bucket_begin) {
-    if (equal(bucket_begin->first, key)) {
-      return bucket_begin;
+  RehashTimer timer(stats_);
+  std::vector<ListIterator> buckets(count, null_bucket());
+  old_buckets_ = std::exchange(buckets_, std::move(buckets));
+  migrated_ = 0;
+  migrate(migration_step);
+}
+
+// nodes of one old bucket are relinked to the front of their new buckets, so
+// every bucket of both arrays stays a contiguous run of the list
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::migrate(size_t count) noexcept {
+  if (old_buckets_.empty()) {
+    return;
+  }
+  [[maybe_unused]] std::chrono::steady_clock::time_point start;
+  if constexpr (CollectStats) {
+    ++stats_.migration_steps;
+    start = std::chrono::steady_clock::now();
+  }
+  for (; count > 0 && migrated_ < old_buckets_.size(); --count, ++migrated_) {
+    ListIterator iter = old_buckets_[migrated_];
+    if (iter == null_bucket()) {
+      continue;
+    }
+    while (iter != values_.end() && in_old_buckets(iter->hash) &&
+           bucket_index(iter->hash, old_buckets_.size()) == migrated_) {
+      ListIterator next = iter;
+      ++next;
+      ListIterator& bucket = buckets_[bucket_index(iter->hash)];
+      values_.splice(bucket == null_bucket() ? values_.begin() : bucket,
+                     values_, iter);
+      bucket = iter;
+      iter = next;
     }
   }
-  return this->end();
+  if (migrated_ == old_buckets_.size()) {
+    old_buckets_ = std::vector<ListIterator>();
+    migrated_ = 0;
+  }
+  if constexpr (CollectStats) {
+    stats_.rehash_time += std::chrono::steady_clock::now() - start;
+  }
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-Value& UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator[](
-    const Key& key) {
-  iterator result = find(key);
-  if (result == end()) {
-    emplace(key, Value());
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename... Args>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                                BucketPolicy, CollectStats>::iterator,
+          bool>
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::emplace(Args&&... args) {
+  if constexpr (IsKeyValueArgs<Key, Args...>::value) {
+    return try_emplace(std::forward<Args>(args)...);
+  } else {
+    std::pair<Key, Value> node(std::forward<Args>(args)...);
+    size_t hash = hash_(node.first);
+    ListIterator iter = find_hashed(node.first, hash);
+    if (iter != values_.end()) {
+      return {iter, false};
+    }
+    grow_if_needed();
+    return {emplace_hashed(hash, std::move(node.first), std::move(node.second)),
+            true};
   }
-  return *find(key);
 }
 
+// looks the key up before constructing anything, so a hit never allocates
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(
-    UnorderedMap::const_iterator iter) {
-  auto hash = get_hash(iter->first);
-  iterator result = end();
-  if (std::next(iter) != cend()) {
-    result = find(std::next(iter)->first);
-    assert(result != end());
-  }
-  if (iter == const_iterator(buckets_[hash])) {
-    if (result != end() && get_hash(result->first) == hash) {
-      buckets_[hash] = result.node;
-    } else {
-      buckets_[hash] = values_.end();
-    }
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename K, typename... Args>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                                BucketPolicy, CollectStats>::iterator,
+          bool>
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::try_emplace_hashed(
+    size_t hash, K&& key, Args&&... args) {
+  ListIterator iter = find_hashed(key, hash);
+  if (iter != values_.end()) {
+    return {iter, false};
+  }
+  grow_if_needed();
+  return {emplace_hashed(hash, std::piecewise_construct,
+                         std::forward_as_tuple(std::forward<K>(key)),
+                         std::forward_as_tuple(std::forward<Args>(args)...)),
+          true};
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+template <typename K, typename M>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                                BucketPolicy, CollectStats>::iterator,
+          bool>
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::insert_or_assign_impl(K&& key,
+                                                                M&& value) {
+  auto result = try_emplace_impl(std::forward<K>(key), std::forward<M>(value));
+  if (!result.second) {
+    // value was not consumed by try_emplace_impl on a hit
+    result.first->second = std::forward<M>(value);
   }
+  return result;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::iterator
+UnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy, CollectStats>::erase(
+    UnorderedMap::const_iterator iter) {
+  ListIterator node(iter.node.node);
+  ListIterator result = node;
+  ++result;
+  unlink_bucket(node);
   values_.erase(iter.node);
   return result;
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::iterator
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                  BucketPolicy, CollectStats>::unlink_bucket(
+    ListIterator iter) noexcept {
+  ListIterator& bucket = bucket_of(iter->hash);
+  if (iter != bucket) {
+    return;
+  }
+  ListIterator next = iter;
+  ++next;
+  if (next != values_.end() && same_bucket(next->hash, iter->hash)) {
+    bucket = next;
+  } else {
+    bucket = null_bucket();
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::NodeHandle
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::extract(
+    UnorderedMap::const_iterator iter) noexcept {
+  unlink_bucket(ListIterator(iter.node.node));
+  return NodeHandle(values_.extract(iter.node));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::NodeHandle
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::extract(const Key& key) {
+  iterator iter = find(key);
+  if (iter == end()) {
+    return NodeHandle();
+  }
+  return extract(iter);
+}
+
+// the stored hash is taken again, the source map may hash differently
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::InsertResult
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::insert(NodeHandle&& node) {
+  if (node.empty()) {
+    return {end(), false, NodeHandle()};
+  }
+  Entry& entry = node.handle_.value();
+  size_t hash = hash_(entry.value.first);
+  ListIterator iter = find_hashed(entry.value.first, hash);
+  if (iter != values_.end()) {
+    return {iter, false, std::move(node)};
+  }
+  grow_if_needed();
+  entry.hash = hash;
+  ListIterator& bucket = bucket_of(hash);
+  bucket = values_.insert(bucket == null_bucket() ? values_.begin() : bucket,
+                          std::move(node.handle_));
+  return {bucket, true, NodeHandle()};
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      BucketPolicy, CollectStats>::iterator
+UnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy, CollectStats>::erase(
     UnorderedMap::const_iterator first, UnorderedMap::const_iterator second) {
   iterator iter = end();
   while (first != second) {
@@ -700,46 +2151,64 @@ UnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc>&
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator=(UnorderedMap&& map) {
-  values_.clear();
-  buckets_.assign(map.buckets_.size(), values_.end());
-  map.buckets_.clear();
-  while (!map.values_.is_empty()) {
-    auto& item = *map.values_.begin();
-    emplace(const_cast<Key&&>(std::move(item.first)), std::move(item.second));
-    map.values_.pop_front();
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy, CollectStats>&
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::operator=(
+    UnorderedMap&& map) {
+  if (this == &map) {
+    return *this;
+  }
+  bool steal = EntryTraits::propagate_on_container_move_assignment::value ||
+               values_.get_allocator() == map.values_.get_allocator();
+  max_factor_ = map.max_factor_;
+  hash_ = std::move(map.hash_);
+  equal_ = std::move(map.equal_);
+  incremental_ = map.incremental_;
+  migrated_ = map.migrated_;
+  values_ = std::move(map.values_);
+  if (steal) {
+    buckets_ = std::move(map.buckets_);
+    old_buckets_ = std::move(map.old_buckets_);
+  } else {
+    rebuild_buckets(map.bucket_count(), map.old_buckets_.size());
   }
+  map.buckets_.clear();
+  map.old_buckets_.clear();
+  map.migrated_ = 0;
   return *this;
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap&& map)
-    : UnorderedMap(map.get_allocator()) {
-  buckets_.assign(map.bucket_count(), values_.end());
+          typename Alloc, typename BucketPolicy, bool CollectStats>
+UnorderedMap<Key, Value, Hash, Equal, Alloc,
+             BucketPolicy, CollectStats>::UnorderedMap(
+    UnorderedMap&& map) noexcept
+    : max_factor_(map.max_factor_),
+      hash_(std::move(map.hash_)),
+      equal_(std::move(map.equal_)),
+      values_(std::move(map.values_)),
+      buckets_(std::move(map.buckets_)),
+      old_buckets_(std::move(map.old_buckets_)),
+      migrated_(std::exchange(map.migrated_, 0)),
+      incremental_(map.incremental_) {
   map.buckets_.clear();
-  while (!map.values_.is_empty()) {
-    auto& item = *map.values_.begin();
-    emplace(const_cast<Key&&>(std::move(item.first)), std::move(item.second));
-    map.values_.pop_front();
-  }
+  map.old_buckets_.clear();
 }
 
 template <typename Key, typename Value, typename Hash, typename Equal,
-          typename Alloc>
+          typename Alloc, typename BucketPolicy, bool CollectStats>
 template <bool is_const>
-struct UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator {
+struct UnorderedMap<Key, Value, Hash, Equal, Alloc,
+                    BucketPolicy, CollectStats>::Iterator {
   using value_type = std::conditional_t<is_const, const NodeType, NodeType>;
   using pointer = value_type*;
   using reference = value_type&;
   using difference_type = int;
   using iterator_category = std::forward_iterator_tag;
-  using DataType =
-      std::conditional_t<is_const,
-                         typename List<NodeType, Alloc>::const_iterator,
-                         typename List<NodeType, Alloc>::iterator>;
+  using DataType = std::conditional_t<is_const,
+                                      typename ListType::const_iterator,
+                                      typename ListType::iterator>;
   DataType node;
 
   operator Iterator<true>() const {
@@ -766,10 +2235,1085 @@ struct UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator {
   }
 
   pointer operator->() {
-    return node.operator->();
+    return &node->value;
   }
 
   reference operator*() {
-    return *node;
+    return node->value;
+  }
+};
+
+// reads are served by the snapshot until the first change, which copies it
+// into an UnorderedMap once; the snapshot bytes must outlive the view
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+class SnapshotUnorderedMap {
+ public:
+  using SnapshotType = MappedUnorderedMap<Key, Value, Hash, Equal>;
+  using MapType = UnorderedMap<Key, Value, Hash, Equal>;
+
+  explicit SnapshotUnorderedMap(SnapshotType snapshot)
+      : snapshot_(snapshot) {
+  }
+
+  inline bool promoted() const noexcept {
+    return map_.has_value();
+  }
+
+  size_t size() const noexcept {
+    return promoted() ? map_->size() : snapshot_.size();
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  // null when the key is missing
+  const Value* find(const Key& key) const {
+    if (promoted()) {
+      auto iter = map_->find(key);
+      return iter == map_->end() ? nullptr : &iter->second;
+    }
+    auto record = snapshot_.find(key);
+    return record == nullptr ? nullptr : &record->value;
+  }
+
+  bool contains(const Key& key) const {
+    return find(key) != nullptr;
+  }
+
+  const Value& at(const Key& key) const {
+    return promoted() ? map_->at(key) : snapshot_.at(key);
+  }
+
+  Value& operator[](const Key& key) {
+    return promote()[key];
+  }
+
+  // every pointer and reference taken from the snapshot stays valid, the
+  // copy does not share them
+  MapType& promote() {
+    if (!promoted()) {
+      map_.emplace(snapshot_);
+    }
+    return *map_;
+  }
+
+ private:
+  SnapshotType snapshot_;
+  std::optional<MapType> map_;
+};
+
+// every operation locks only the shard picked by the top bits of the mixed
+// hash, readers share the lock; iterators and references are never handed
+// out, values are read and changed through callbacks under the lock
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>,
+          typename Alloc = std::allocator<std::pair<const Key, Value>>,
+          typename BucketPolicy = ModuloBuckets, size_t ShardCount = 16>
+class ConcurrentUnorderedMap {
+ public:
+  using MapType = UnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy>;
+  using NodeType = typename MapType::NodeType;
+
+  static_assert(std::has_single_bit(ShardCount),
+                "shard count must be a power of two");
+
+  ConcurrentUnorderedMap(Alloc alloc = Alloc());
+
+  ConcurrentUnorderedMap(const ConcurrentUnorderedMap&) = delete;
+
+  ConcurrentUnorderedMap& operator=(const ConcurrentUnorderedMap&) = delete;
+
+  ~ConcurrentUnorderedMap() = default;
+
+  constexpr static size_t shard_count() noexcept {
+    return ShardCount;
+  }
+
+  // shards are counted one after another, so under concurrent writes the
+  // result is only a snapshot
+  size_t size() const;
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  bool contains(const Key& key) const {
+    return visit(key, [](const Value&) {});
+  }
+
+  std::optional<Value> find(const Key& key) const;
+
+  template <typename F>
+  bool visit(const Key& key, F&& func) const;
+
+  template <typename F>
+  bool update(const Key& key, F&& func);
+
+  template <typename... Args>
+  bool try_emplace(const Key& key, Args&&... args) {
+    return try_emplace_impl(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  bool try_emplace(Key&& key, Args&&... args) {
+    return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+  }
+
+  bool insert(const NodeType& node) {
+    return try_emplace(node.first, node.second);
+  }
+
+  template <typename M>
+  bool insert_or_assign(const Key& key, M&& value);
+
+  bool erase(const Key& key);
+
+  void clear();
+
+  // the count is split evenly between shards, each shard is rebuilt under
+  // its own lock while the others keep serving requests
+  void rehash(size_t count);
+
+  void reserve(size_t count);
+
+  void max_load_factor(double new_factor);
+
+  void incremental_rehash(bool enable);
+
+  template <typename F>
+  void for_each(F&& func) const;
+
+ private:
+  constexpr static size_t cache_line_size = 64;
+
+  struct alignas(cache_line_size) Shard {
+    mutable std::shared_mutex mutex;
+    MapType map;
+  };
+
+  inline static size_t shard_index(size_t hash) noexcept {
+    if constexpr (ShardCount == 1) {
+      return 0;
+    } else {
+      hash *= static_cast<size_t>(0x9E3779B97F4A7C15ULL);
+      return hash >> (sizeof(size_t) * CHAR_BIT - std::countr_zero(ShardCount));
+    }
+  }
+
+  inline static size_t per_shard(size_t count) noexcept {
+    return (count + ShardCount - 1) / ShardCount;
+  }
+
+  template <typename K, typename... Args>
+  bool try_emplace_impl(K&& key, Args&&... args);
+
+  [[no_unique_address]] Hash hash_;
+  std::array<Shard, ShardCount> shards_;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                       ShardCount>::ConcurrentUnorderedMap(Alloc alloc) {
+  for (auto& shard : shards_) {
+    shard.map = MapType(alloc);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+size_t ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                              ShardCount>::size() const {
+  size_t result = 0;
+  for (const auto& shard : shards_) {
+    std::shared_lock lock(shard.mutex);
+    result += shard.map.size();
+  }
+  return result;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+std::optional<Value> ConcurrentUnorderedMap<
+    Key, Value, Hash, Equal, Alloc, BucketPolicy,
+    ShardCount>::find(const Key& key) const {
+  std::optional<Value> result;
+  visit(key, [&result](const Value& value) { result.emplace(value); });
+  return result;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+template <typename F>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::visit(const Key& key,
+                                               F&& func) const {
+  size_t hash = hash_(key);
+  Shard& shard = const_cast<Shard&>(shards_[shard_index(hash)]);
+  std::shared_lock lock(shard.mutex);
+  typename MapType::iterator iter = shard.map.find_hashed(key, hash);
+  if (iter == shard.map.end()) {
+    return false;
+  }
+  std::forward<F>(func)(std::as_const(iter->second));
+  return true;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+template <typename F>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::update(const Key& key, F&& func) {
+  size_t hash = hash_(key);
+  Shard& shard = shards_[shard_index(hash)];
+  std::unique_lock lock(shard.mutex);
+  typename MapType::iterator iter = shard.map.find_hashed(key, hash);
+  if (iter == shard.map.end()) {
+    return false;
+  }
+  std::forward<F>(func)(iter->second);
+  return true;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+template <typename K, typename... Args>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::try_emplace_impl(K&& key,
+                                                          Args&&... args) {
+  size_t hash = hash_(key);
+  Shard& shard = shards_[shard_index(hash)];
+  std::unique_lock lock(shard.mutex);
+  return shard.map
+      .try_emplace_hashed(hash, std::forward<K>(key),
+                          std::forward<Args>(args)...)
+      .second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+template <typename M>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::insert_or_assign(const Key& key,
+                                                          M&& value) {
+  size_t hash = hash_(key);
+  Shard& shard = shards_[shard_index(hash)];
+  std::unique_lock lock(shard.mutex);
+  auto result = shard.map.try_emplace_hashed(hash, key, std::forward<M>(value));
+  if (!result.second) {
+    result.first->second = std::forward<M>(value);
+  }
+  return result.second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::erase(const Key& key) {
+  size_t hash = hash_(key);
+  Shard& shard = shards_[shard_index(hash)];
+  std::unique_lock lock(shard.mutex);
+  typename MapType::iterator iter = shard.map.find_hashed(key, hash);
+  if (iter == shard.map.end()) {
+    return false;
+  }
+  shard.map.erase(iter);
+  return true;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::clear() {
+  for (auto& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    shard.map.erase(shard.map.begin(), shard.map.end());
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::rehash(size_t count) {
+  for (auto& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    shard.map.rehash(per_shard(count));
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::reserve(size_t count) {
+  for (auto& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    shard.map.reserve(per_shard(count));
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::max_load_factor(double new_factor) {
+  for (auto& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    shard.map.max_load_factor(new_factor);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::incremental_rehash(bool enable) {
+  for (auto& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    shard.map.incremental_rehash(enable);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename BucketPolicy, size_t ShardCount>
+template <typename F>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, BucketPolicy,
+                            ShardCount>::for_each(F&& func) const {
+  for (const auto& shard : shards_) {
+    std::shared_lock lock(shard.mutex);
+    for (const auto& node : shard.map) {
+      func(node);
+    }
+  }
+}
+
+struct LinearProbing {};
+
+struct RobinHoodProbing {};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>,
+          typename Alloc = std::allocator<std::pair<const Key, Value>>,
+          typename Probing = LinearProbing>
+class FlatUnorderedMap {
+ public:
+  using NodeType = std::pair<const Key, Value>;
+
+ private:
+  struct Control;
+
+  template <bool is_const>
+  struct Iterator;
+
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatUnorderedMap(Alloc alloc = Alloc())
+      : max_factor_(default_factor),
+        alloc_(alloc),
+        control_alloc_(alloc_) {
+  }
+
+  FlatUnorderedMap(const FlatUnorderedMap& map);
+
+  FlatUnorderedMap(FlatUnorderedMap&& map) noexcept;
+
+  FlatUnorderedMap& operator=(const FlatUnorderedMap& map);
+
+  FlatUnorderedMap& operator=(FlatUnorderedMap&& map);
+
+  ~FlatUnorderedMap() {
+    clear();
+    deallocate(slots_, control_, capacity_);
+  }
+
+  inline size_t size() const noexcept {
+    return size_;
+  }
+
+  inline auto get_allocator() const noexcept {
+    return alloc_;
+  }
+
+  inline size_t bucket_count() const noexcept {
+    return capacity_;
+  }
+
+  inline auto load_factor() const noexcept {
+    return static_cast<double>(size()) / bucket_count();
+  }
+
+  inline auto max_load_factor() const noexcept {
+    return max_factor_;
+  }
+
+  // open addressing needs at least one empty slot to terminate probing
+  inline void max_load_factor(double new_factor) noexcept {
+    max_factor_ = std::min(new_factor, max_factor_limit);
+  }
+
+  inline iterator begin() noexcept {
+    return {this, begin_index()};
+  }
+
+  inline const_iterator begin() const noexcept {
+    return {this, begin_index()};
+  }
+
+  inline const_iterator cbegin() const noexcept {
+    return begin();
+  }
+
+  inline iterator end() noexcept {
+    return {this, capacity_};
+  }
+
+  inline const_iterator end() const noexcept {
+    return {this, capacity_};
+  }
+
+  inline const_iterator cend() const noexcept {
+    return end();
+  }
+
+  Value& at(const Key& key);
+
+  const Value& at(const Key& key) const;
+
+  void rehash(size_t count);
+
+  void reserve(size_t count) {
+    rehash(std::ceil(count / max_load_factor()));
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args);
+
+  std::pair<iterator, bool> insert(const NodeType& node) {
+    return emplace(node.first, node.second);
+  }
+
+  std::pair<iterator, bool> insert(NodeType&& node) {
+    return emplace(const_cast<Key&&>(std::move(node.first)),
+                   std::move(node.second));
+  }
+
+  template <typename InputIt>
+  void insert(InputIt begin, InputIt end);
+
+  const_iterator find(const Key& key) const {
+    return {this, find_index(key, get_hash(key))};
+  }
+
+  iterator find(const Key& key) {
+    return {this, find_index(key, get_hash(key))};
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  Value& operator[](const Key& key);
+
+  Value& operator[](Key&& key);
+
+  iterator erase(const_iterator iter);
+
+  iterator erase(const_iterator first, const_iterator second);
+
+  void clear() noexcept;
+
+ private:
+  using AllocTraits = std::allocator_traits<Alloc>;
+  using ControlAlloc = typename AllocTraits::template rebind_alloc<Control>;
+  using ControlTraits = std::allocator_traits<ControlAlloc>;
+
+  constexpr static bool robin_hood = std::is_same_v<Probing, RobinHoodProbing>;
+
+  // Control::distance is 0 for an empty slot, deleted_slot for a tombstone
+  // (linear probing only, Robin Hood shifts back instead) and probe
+  // distance + 1 (saturated at saturated_distance) otherwise
+  constexpr static uint8_t empty_slot = 0;
+  constexpr static uint8_t saturated_distance = 0xFE;
+  constexpr static uint8_t deleted_slot = 0xFF;
+
+  inline static bool is_full(const Control& control) noexcept {
+    return control.distance != empty_slot && control.distance != deleted_slot;
+  }
+
+  inline static uint8_t to_distance(size_t probe) noexcept {
+    return static_cast<uint8_t>(
+        std::min(probe + 1, static_cast<size_t>(saturated_distance)));
+  }
+
+  // spreads std::hash identity values so that both the low bits (slot index)
+  // and the top byte (fingerprint) depend on every bit of the key hash
+  inline size_t get_hash(const Key& key) const {
+    size_t hash = hash_(key) * static_cast<size_t>(0x9E3779B97F4A7C15ULL);
+    return hash ^ (hash >> (sizeof(size_t) * CHAR_BIT / 2));
+  }
+
+  inline static uint8_t fingerprint(size_t hash) noexcept {
+    return static_cast<uint8_t>(hash >> ((sizeof(size_t) - 1) * CHAR_BIT));
+  }
+
+  inline size_t home(size_t hash) const noexcept {
+    return hash & (capacity_ - 1);
+  }
+
+  inline size_t next(size_t index) const noexcept {
+    return (index + 1) & (capacity_ - 1);
+  }
+
+  inline size_t prev(size_t index) const noexcept {
+    return (index - 1) & (capacity_ - 1);
+  }
+
+  size_t probe_distance(size_t index) const;
+
+  size_t first_full(size_t index) const noexcept;
+
+  size_t next_full(size_t index) const noexcept;
+
+  inline size_t begin_index() const noexcept {
+    if constexpr (robin_hood) {
+      return capacity_ == 0 ? 0 : next_full(start_);
+    } else {
+      return first_full(0);
+    }
+  }
+
+  size_t find_index(const Key& key, size_t hash) const;
+
+  size_t prepare_slot(size_t hash);
+
+  void close_hole(size_t hole);
+
+  void relocate(size_t from, size_t to);
+
+  void grow_if_needed();
+
+  void allocate(size_t count);
+
+  void deallocate(NodeType* slots, Control* control, size_t count) noexcept;
+
+  void steal(FlatUnorderedMap& map) noexcept;
+
+  double max_factor_;
+  constexpr static double default_factor = 0.75;
+  constexpr static double max_factor_limit = 0.95;
+  constexpr static double growing_coefficient = 2;
+  constexpr static size_t default_start_size = 16;
+  [[no_unique_address]] Hash hash_;
+  [[no_unique_address]] Equal equal_;
+  [[no_unique_address]] Alloc alloc_;
+  [[no_unique_address]] ControlAlloc control_alloc_;
+  NodeType* slots_ = nullptr;
+  Control* control_ = nullptr;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  size_t deleted_ = 0;
+  // an empty slot Robin Hood iteration starts after, see next_full()
+  size_t start_ = 0;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+struct FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::Control {
+  uint8_t distance;
+  uint8_t fingerprint;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::FlatUnorderedMap(
+    const FlatUnorderedMap& map)
+    : max_factor_(map.max_factor_),
+      hash_(map.hash_),
+      equal_(map.equal_),
+      alloc_(AllocTraits::select_on_container_copy_construction(map.alloc_)),
+      control_alloc_(alloc_) {
+  if (map.capacity_ == 0) {
+    return;
+  }
+  allocate(map.capacity_);
+  try {
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (is_full(map.control_[i])) {
+        AllocTraits::construct(alloc_, slots_ + i, map.slots_[i]);
+        ++size_;
+      }
+      control_[i] = map.control_[i];
+    }
+    deleted_ = map.deleted_;
+    start_ = map.start_;
+  } catch (...) {
+    clear();
+    deallocate(slots_, control_, capacity_);
+    throw;
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::FlatUnorderedMap(
+    FlatUnorderedMap&& map) noexcept
+    : max_factor_(map.max_factor_),
+      hash_(std::move(map.hash_)),
+      equal_(std::move(map.equal_)),
+      alloc_(std::move(map.alloc_)),
+      control_alloc_(alloc_) {
+  steal(map);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>&
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::operator=(
+    const FlatUnorderedMap& map) {
+  if (this != &map) {
+    FlatUnorderedMap copy = map;
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>&
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::operator=(
+    FlatUnorderedMap&& map) {
+  if (this == &map) {
+    return *this;
+  }
+  clear();
+  max_factor_ = map.max_factor_;
+  hash_ = std::move(map.hash_);
+  equal_ = std::move(map.equal_);
+  if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+    deallocate(slots_, control_, capacity_);
+    alloc_ = std::move(map.alloc_);
+    control_alloc_ = ControlAlloc(alloc_);
+    steal(map);
+  } else {
+    if (alloc_ == map.alloc_) {
+      deallocate(slots_, control_, capacity_);
+      steal(map);
+    } else {
+      reserve(map.size());
+      for (auto& item : map) {
+        insert(std::move(item));
+      }
+      map.clear();
+    }
+  }
+  return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::steal(
+    FlatUnorderedMap& map) noexcept {
+  slots_ = std::exchange(map.slots_, nullptr);
+  control_ = std::exchange(map.control_, nullptr);
+  capacity_ = std::exchange(map.capacity_, 0);
+  size_ = std::exchange(map.size_, 0);
+  deleted_ = std::exchange(map.deleted_, 0);
+  start_ = std::exchange(map.start_, 0);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+Value& FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::at(
+    const Key& key) {
+  iterator result = find(key);
+  if (result == end()) {
+    throw std::out_of_range("no such element");
+  }
+  return result->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+const Value& FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::at(
+    const Key& key) const {
+  const_iterator result = find(key);
+  if (result == cend()) {
+    throw std::out_of_range("no such element");
+  }
+  return result->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+Value& FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::operator[](
+    const Key& key) {
+  iterator result = find(key);
+  if (result != end()) {
+    return result->second;
+  }
+  return emplace(key, Value()).first->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+Value& FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::operator[](
+    Key&& key) {
+  iterator result = find(key);
+  if (result != end()) {
+    return result->second;
+  }
+  return emplace(std::move(key), Value()).first->second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::rehash(
+    size_t count) {
+  count = std::max(count, static_cast<size_t>(size() / max_load_factor()) + 1);
+  count = std::bit_ceil(std::max(count, default_start_size));
+  if (count == capacity_ && deleted_ == 0) {
+    return;
+  }
+  NodeType* old_slots = slots_;
+  Control* old_control = control_;
+  size_t old_capacity = capacity_;
+  allocate(count);
+  size_ = 0;
+  deleted_ = 0;
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (is_full(old_control[i])) {
+      NodeType& item = old_slots[i];
+      size_t index = prepare_slot(get_hash(item.first));
+      AllocTraits::construct(alloc_, slots_ + index,
+                             const_cast<Key&&>(std::move(item.first)),
+                             std::move(item.second));
+      AllocTraits::destroy(alloc_, old_slots + i);
+    }
+  }
+  deallocate(old_slots, old_control, old_capacity);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+template <typename InputIt>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::insert(
+    InputIt begin, InputIt end) {
+  for (auto it = begin; it != end; ++it) {
+    insert(*it);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+template <typename... Args>
+std::pair<typename FlatUnorderedMap<Key, Value, Hash, Equal, Alloc,
+                                    Probing>::iterator,
+          bool>
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::emplace(
+    Args&&... args) {
+  std::pair<Key, Value> node(std::forward<Args>(args)...);
+  size_t hash = get_hash(node.first);
+  size_t index = find_index(node.first, hash);
+  if (index != capacity_) {
+    return {{this, index}, false};
+  }
+  grow_if_needed();
+  index = prepare_slot(hash);
+  try {
+    AllocTraits::construct(alloc_, slots_ + index, std::move(node.first),
+                           std::move(node.second));
+  } catch (...) {
+    --size_;
+    if constexpr (robin_hood) {
+      close_hole(index);
+    } else {
+      control_[index].distance = deleted_slot;
+      ++deleted_;
+    }
+    throw;
+  }
+  return {{this, index}, true};
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+typename FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::iterator
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::erase(
+    const_iterator iter) {
+  size_t hole = iter.index;
+  AllocTraits::destroy(alloc_, slots_ + hole);
+  --size_;
+  if constexpr (robin_hood) {
+    close_hole(hole);
+    return {this, is_full(control_[hole]) ? hole : next_full(hole)};
+  } else {
+    if (control_[next(hole)].distance == empty_slot) {
+      control_[hole].distance = empty_slot;
+    } else {
+      control_[hole].distance = deleted_slot;
+      ++deleted_;
+    }
+    return {this, first_full(hole)};
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+typename FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::iterator
+FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::erase(
+    const_iterator first, const_iterator second) {
+  // backward shifting may move elements under second, so count instead
+  size_t count = 0;
+  for (auto it = first; it != second; ++it) {
+    ++count;
+  }
+  iterator iter = {this, first.index};
+  while (count-- > 0) {
+    iter = erase(iter);
+  }
+  return iter;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      Probing>::clear() noexcept {
+  for (size_t i = 0; i < capacity_; ++i) {
+    if (is_full(control_[i])) {
+      AllocTraits::destroy(alloc_, slots_ + i);
+    }
+    control_[i].distance = empty_slot;
+  }
+  size_ = 0;
+  deleted_ = 0;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+size_t FlatUnorderedMap<Key, Value, Hash, Equal, Alloc,
+                        Probing>::probe_distance(size_t index) const {
+  if (control_[index].distance != saturated_distance) {
+    return control_[index].distance - 1;
+  }
+  return (index - home(get_hash(slots_[index].first))) & (capacity_ - 1);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+size_t FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::first_full(
+    size_t index) const noexcept {
+  while (index < capacity_ && !is_full(control_[index])) {
+    ++index;
+  }
+  return index;
+}
+
+// the entry after index in iteration order, capacity_ past the last one.
+// Robin Hood iteration goes round from the empty slot start_: the backward
+// shift of an erase stops at an empty slot, so it never carries an entry
+// from behind the iterator to ahead of it, not even across the wrap-around
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+size_t FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::next_full(
+    size_t index) const noexcept {
+  if constexpr (robin_hood) {
+    for (index = next(index); index != start_; index = next(index)) {
+      if (is_full(control_[index])) {
+        return index;
+      }
+    }
+    return capacity_;
+  } else {
+    return first_full(index + 1);
+  }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+size_t FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::find_index(
+    const Key& key, size_t hash) const {
+  if (empty()) {
+    return capacity_;
+  }
+  uint8_t print = fingerprint(hash);
+  size_t index = home(hash);
+  for (size_t probe = 0; probe < capacity_; ++probe, index = next(index)) {
+    const Control& control = control_[index];
+    if (control.distance == empty_slot) {
+      break;
+    }
+    if constexpr (robin_hood) {
+      if (control.distance < to_distance(probe)) {
+        break;
+      }
+    }
+    if (control.distance != deleted_slot && control.fingerprint == print &&
+        equal_(slots_[index].first, key)) {
+      return index;
+    }
+  }
+  return capacity_;
+}
+
+// returns an unconstructed slot for a new entry and marks it as full
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+size_t FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::prepare_slot(
+    size_t hash) {
+  size_t index = home(hash);
+  size_t probe = 0;
+  if constexpr (robin_hood) {
+    while (is_full(control_[index]) &&
+           control_[index].distance >= to_distance(probe)) {
+      index = next(index);
+      ++probe;
+    }
+    size_t last = index;
+    while (is_full(control_[last])) {
+      last = next(last);
+    }
+    for (; last != index; last = prev(last)) {
+      // a saturated distance is recomputed from the key, before it moves
+      size_t probe = probe_distance(prev(last));
+      relocate(prev(last), last);
+      control_[last] = {to_distance(probe + 1),
+                        control_[prev(last)].fingerprint};
+    }
+  } else {
+    while (is_full(control_[index])) {
+      index = next(index);
+      ++probe;
+    }
+    if (control_[index].distance == deleted_slot) {
+      --deleted_;
+    }
+  }
+  control_[index] = {to_distance(probe), fingerprint(hash)};
+  ++size_;
+  if constexpr (robin_hood) {
+    while (is_full(control_[start_])) {
+      start_ = next(start_);
+    }
+  }
+  return index;
+}
+
+// shifts the displaced entries after an empty hole back by one
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::close_hole(
+    size_t hole) {
+  size_t index = next(hole);
+  while (is_full(control_[index]) && control_[index].distance > 1) {
+    size_t probe = probe_distance(index);
+    relocate(index, hole);
+    control_[hole] = {to_distance(probe - 1), control_[index].fingerprint};
+    hole = index;
+    index = next(index);
+  }
+  control_[hole].distance = empty_slot;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::relocate(
+    size_t from, size_t to) {
+  AllocTraits::construct(alloc_, slots_ + to,
+                         const_cast<Key&&>(std::move(slots_[from].first)),
+                         std::move(slots_[from].second));
+  AllocTraits::destroy(alloc_, slots_ + from);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc,
+                      Probing>::grow_if_needed() {
+  size_t limit = static_cast<size_t>(bucket_count() * max_load_factor());
+  if (size() + deleted_ + 1 <= limit) {
+    return;
+  }
+  if (size() + 1 <= limit) {
+    // only tombstones are in the way, rebuild in place
+    rehash(bucket_count());
+    return;
+  }
+  reserve(std::max(default_start_size, static_cast<size_t>(std::ceil(
+                                           growing_coefficient * size()))));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::allocate(
+    size_t count) {
+  Control* control = ControlTraits::allocate(control_alloc_, count);
+  try {
+    slots_ = AllocTraits::allocate(alloc_, count);
+  } catch (...) {
+    ControlTraits::deallocate(control_alloc_, control, count);
+    throw;
+  }
+  control_ = control;
+  std::uninitialized_fill_n(control_, count, Control{empty_slot, 0});
+  capacity_ = count;
+  start_ = 0;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+void FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::deallocate(
+    NodeType* slots, Control* control, size_t count) noexcept {
+  if (count == 0) {
+    return;
+  }
+  AllocTraits::deallocate(alloc_, slots, count);
+  ControlTraits::deallocate(control_alloc_, control, count);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal,
+          typename Alloc, typename Probing>
+template <bool is_const>
+struct FlatUnorderedMap<Key, Value, Hash, Equal, Alloc, Probing>::Iterator {
+  using value_type = std::conditional_t<is_const, const NodeType, NodeType>;
+  using pointer = value_type*;
+  using reference = value_type&;
+  using difference_type = int;
+  using iterator_category = std::forward_iterator_tag;
+  using MapType = std::conditional_t<is_const, const FlatUnorderedMap*,
+                                     FlatUnorderedMap*>;
+
+  MapType map;
+  size_t index;
+
+  operator Iterator<true>() const {
+    return {map, index};
+  }
+
+  Iterator(MapType map, size_t index)
+      : map(map),
+        index(index) {
+  }
+
+  Iterator& operator++() {
+    index = map->next_full(index);
+    return *this;
+  }
+
+  inline bool operator==(Iterator other) const noexcept {
+    return index == other.index;
+  }
+
+  Iterator operator++(int) {
+    auto copy = *this;
+    operator++();
+    return copy;
+  }
+
+  pointer operator->() const {
+    return map->slots_ + index;
+  }
+
+  reference operator*() const {
+    return map->slots_[index];
   }
 };
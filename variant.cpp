@@ -1,5 +1,14 @@
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 class BadVariantAccess : std::exception {};
 
@@ -21,11 +30,17 @@ struct GetMaxAlignOf
 template <typename Head>
 struct GetMaxAlignOf<Head> : std::integral_constant<size_t, alignof(Head)> {};
 
+// the smallest type that holds every index and the valueless marker N
+template <size_t N>
+using VariantIndex = std::conditional_t<
+    (N < UINT8_MAX), uint8_t,
+    std::conditional_t<(N < UINT16_MAX), uint16_t, size_t>>;
+
 template <typename... Types>
 struct VariantStorage {
   alignas(GetMaxAlignOf<Types...>::value)
       std::array<std::byte, GetMaxSizeOf<Types...>::value> buffer{};
-  size_t current_index = sizeof...(Types);
+  VariantIndex<sizeof...(Types)> current_index = sizeof...(Types);
 };
 
 template <typename T, typename Head, typename... Tail>
@@ -59,9 +74,11 @@ template <typename T, typename... Types>
 struct VariantChoice {
   using Derived = Variant<Types...>;
 
+  // empty and never copied on their own, defaulted only so that Variant's
+  // copies can stay trivial
   VariantChoice() = default;
-  VariantChoice(const VariantChoice&) = delete;
-  VariantChoice& operator=(const VariantChoice&) = delete;
+  VariantChoice(const VariantChoice&) = default;
+  VariantChoice& operator=(const VariantChoice&) = default;
 
   static constexpr size_t type_index = get_index_v<T, Types...>;
 
@@ -117,6 +134,8 @@ class Variant : private VariantStorage<Types...>,
   template <typename T, typename... Args>
   friend struct VariantChoice;
 
+  friend struct VariantAccess;
+
   template <typename T, typename... Args,
             std::enable_if_t<ContainedInPackage<T, Args...>::value, bool>>
   friend const T& get(const Variant<Args...>&);
@@ -130,9 +149,25 @@ class Variant : private VariantStorage<Types...>,
   friend T&& get(Variant<Args...>&&);
 
   void clear() {
-    (VariantChoice<Types, Types...>::destroy(), ...);
+    if constexpr (!trivially_destructible) {
+      (VariantChoice<Types, Types...>::destroy(), ...);
+    } else {
+      this->current_index = sizeof...(Types);
+    }
   }
 
+  // builds a throwing alternative aside and moves it in, so the old value
+  // is destroyed only once nothing can fail any more
+  template <typename T, typename... Args>
+  T& replace(Args&&... args);
+
+  static constexpr bool trivially_destructible =
+      (std::is_trivially_destructible_v<Types> && ...);
+
+  // copies and moves are then plain byte copies of the storage
+  static constexpr bool trivially_copyable =
+      (std::is_trivially_copyable_v<Types> && ...);
+
  public:
   using VariantChoice<Types, Types...>::VariantChoice...;
 
@@ -140,15 +175,31 @@ class Variant : private VariantStorage<Types...>,
       : VariantChoice<typename First<Types...>::type, Types...>(
             typename First<Types...>::type()){};
 
+  Variant(const Variant& variant)
+    requires trivially_copyable
+  = default;
+
   Variant(const Variant& variant)
       : VariantStorage<Types...>(),
         VariantChoice<Types, Types...>()... {
     (VariantChoice<Types, Types...>::construct(variant), ...);
   }
 
-  auto& operator=(const Variant& variant);
+  Variant& operator=(const Variant& variant)
+    requires trivially_copyable
+  = default;
+
+  Variant& operator=(const Variant& variant);
+
+  Variant& operator=(Variant&& variant)
+    requires trivially_copyable
+  = default;
+
+  Variant& operator=(Variant&& variant);
 
-  auto& operator=(Variant&& variant);
+  Variant(Variant&& variant)
+    requires trivially_copyable
+  = default;
 
   Variant(Variant&& variant) {
     (VariantChoice<Types, Types...>::construct(std::move(variant)), ...);
@@ -161,7 +212,15 @@ class Variant : private VariantStorage<Types...>,
   template <size_t N, typename... Args>
   decltype(auto) emplace(Args&&... args);
 
+  // every replacement goes through a nothrow move, so no exception can
+  // leave the variant empty
+  static constexpr bool never_valueless =
+      (std::is_nothrow_move_constructible_v<Types> && ...);
+
   bool valueless_by_exception() const noexcept {
+    if constexpr (never_valueless) {
+      return false;
+    }
     return index() == sizeof...(Types);
   }
 
@@ -171,6 +230,10 @@ class Variant : private VariantStorage<Types...>,
   template <typename T, typename U>
   T& emplace(std::initializer_list<U> args);
 
+  ~Variant()
+    requires trivially_destructible
+  = default;
+
   ~Variant() {
     clear();
   }
@@ -210,8 +273,7 @@ void VariantChoice<T, Types...>::assign(const Derived& variant) {
     auto& value = *get_ptr();
     value = new_value;
   } else {
-    this_variant.clear();
-    construct(new_value);
+    this_variant.template replace<T>(new_value);
   }
 }
 
@@ -251,7 +313,7 @@ bool VariantChoice<T, Types...>::contain() const {
 }
 
 template <typename... Types>
-auto& Variant<Types...>::operator=(const Variant& variant) {
+Variant<Types...>& Variant<Types...>::operator=(const Variant& variant) {
   if (this != &variant) {
     (VariantChoice<Types, Types...>::assign(variant), ...);
   }
@@ -259,7 +321,7 @@ auto& Variant<Types...>::operator=(const Variant& variant) {
 }
 
 template <typename... Types>
-auto& Variant<Types...>::operator=(Variant&& variant) {
+Variant<Types...>& Variant<Types...>::operator=(Variant&& variant) {
   if (this != &variant) {
     (VariantChoice<Types, Types...>::assign(std::move(variant)), ...);
   }
@@ -274,21 +336,31 @@ decltype(auto) Variant<Types...>::emplace(Args&&... args) {
 
 template <typename... Types>
 template <typename T, typename... Args>
-T& Variant<Types...>::emplace(Args&&... args) {
-  clear();
-  std::construct_at(VariantChoice<T, Types...>::get_ptr(),
-                    std::forward<Args>(args)...);
+T& Variant<Types...>::replace(Args&&... args) {
+  T* ptr = VariantChoice<T, Types...>::get_ptr();
+  if constexpr (std::is_nothrow_constructible_v<T, Args...> ||
+                !std::is_nothrow_move_constructible_v<T>) {
+    clear();
+    std::construct_at(ptr, std::forward<Args>(args)...);
+  } else {
+    T value(std::forward<Args>(args)...);
+    clear();
+    std::construct_at(ptr, std::move(value));
+  }
   this->current_index = get_index_v<T, Types...>;
-  return *VariantChoice<T, Types...>::get_ptr();
+  return *ptr;
+}
+
+template <typename... Types>
+template <typename T, typename... Args>
+T& Variant<Types...>::emplace(Args&&... args) {
+  return replace<T>(std::forward<Args>(args)...);
 }
 
 template <typename... Types>
 template <typename T, typename U>
 T& Variant<Types...>::emplace(std::initializer_list<U> args) {
-  clear();
-  std::construct_at(VariantChoice<T, Types...>::get_ptr(), args);
-  this->current_index = get_index_v<T, Types...>;
-  return *VariantChoice<T, Types...>::get_ptr();
+  return replace<T>(args);
 }
 
 template <typename T, typename... Types,
@@ -343,121 +415,258 @@ T&& get(Variant<Types...>&& variant) {
   return std::move(reinterpret_cast<T&>(variant.buffer));
 }
 
-template <typename T>
-struct default_integral_constant : std::integral_constant<T, T{}> {};
+template <typename Variant>
+struct VariantSize;
 
-template <typename T1, typename T2>
-struct Concatenation;
+template <typename... Types>
+struct VariantSize<Variant<Types...>>
+    : std::integral_constant<size_t, sizeof...(Types)> {};
+
+// unchecked access for callers that already know the active alternative
+struct VariantAccess {
+  template <size_t N, typename... Types>
+  static auto& get(Variant<Types...>& variant) noexcept {
+    using T = get_type_t<N, Types...>;
+    return *std::launder(reinterpret_cast<T*>(&variant.buffer));
+  }
 
-template <size_t... I1, size_t... I2>
-struct Concatenation<std::index_sequence<I1...>, std::index_sequence<I2...>>
-    : default_integral_constant<std::index_sequence<I1..., I2...>> {};
-template <size_t N>
-struct NullSequence : Concatenation<typename NullSequence<N - 1>::value_type,
-                                    std::index_sequence<0>> {};
+  template <size_t N, typename... Types>
+  static const auto& get(const Variant<Types...>& variant) noexcept {
+    using T = get_type_t<N, Types...>;
+    return *std::launder(reinterpret_cast<const T*>(&variant.buffer));
+  }
 
-template <>
-struct NullSequence<0> : default_integral_constant<std::index_sequence<>> {};
+  template <size_t N, typename... Types>
+  static auto&& get(Variant<Types...>&& variant) noexcept {
+    return std::move(get<N>(variant));
+  }
+};
 
+// one entry per combination of alternatives, the slot of a combination is
+// its indices read as a mixed-radix number with the last variant lowest
 template <typename... Variants>
-struct VariantSizeSequence;
+struct VisitTable {
+  static constexpr std::array<size_t, sizeof...(Variants)> sizes{
+      VariantSize<std::remove_cvref_t<Variants>>::value...};
 
-template <typename... Types, typename... Tail>
-struct VariantSizeSequence<Variant<Types...>, Tail...>
-    : Concatenation<std::index_sequence<sizeof...(Types) - 1>,
-                    typename VariantSizeSequence<Tail...>::value_type> {};
+  static constexpr size_t count =
+      (size_t{1} * ... * VariantSize<std::remove_cvref_t<Variants>>::value);
 
-template <typename... Types>
-struct VariantSizeSequence<Variant<Types...>>
-    : default_integral_constant<std::index_sequence<sizeof...(Types) - 1>> {};
-
-template <typename T1, typename T2>
-struct Equal;
-
-template <typename T1, typename T2>
-struct Match;
-
-template <size_t N, size_t M, size_t... I1, size_t... I2>
-struct Match<std::index_sequence<N, I1...>, std::index_sequence<M, I2...>>
-    : std::conditional_t<
-          sizeof...(I1) == Match<std::index_sequence<I1...>,
-                                 std::index_sequence<I2...>>::value,
-          std::integral_constant<size_t,
-                                 Match<std::index_sequence<I1...>,
-                                       std::index_sequence<I2...>>::value +
-                                     static_cast<size_t>(N == M)>,
-          std::integral_constant<size_t,
-                                 Match<std::index_sequence<I1...>,
-                                       std::index_sequence<I2...>>::value>> {};
-template <size_t N, size_t M>
-struct Match<std::index_sequence<N>, std::index_sequence<M>>
-    : std::integral_constant<size_t, static_cast<size_t>(N == M)> {};
-
-template <size_t... I1, size_t... I2>
-struct Equal<std::index_sequence<I1...>, std::index_sequence<I2...>>
-    : std::conjunction<
-          std::bool_constant<sizeof...(I1) == sizeof...(I2)>,
-          std::bool_constant<Match<std::index_sequence<I1...>,
-                                   std::index_sequence<I2...>>::value ==
-                             sizeof...(I1)>> {};
+  static constexpr size_t alternative(size_t flat, size_t variant) {
+    for (size_t i = sizes.size(); i > variant + 1; --i) {
+      flat /= sizes[i - 1];
+    }
+    return flat % sizes[variant];
+  }
 
-template <size_t N>
-constexpr auto make_null_sequence = NullSequence<N>::value;
+  template <typename Visitor>
+  using Result = std::decay_t<std::invoke_result_t<
+      Visitor, decltype(VariantAccess::get<0>(std::declval<Variants>()))...>>;
 
-template <typename... Args>
-struct Full;
+  template <typename Visitor>
+  using Entry = Result<Visitor> (*)(Visitor&&, Variants&&...);
 
-template <typename... Variants, size_t... I>
-struct Full<std::index_sequence<I...>, Variants...>
-    : Equal<
-          std::index_sequence<I...>,
-          typename VariantSizeSequence<std::decay_t<Variants>...>::value_type> {
-};
+  template <typename Visitor, size_t Flat, size_t... I>
+  static Result<Visitor> invoke(std::index_sequence<I...>, Visitor&& visitor,
+                                Variants&&... variants) {
+    return std::invoke(std::forward<Visitor>(visitor),
+                       VariantAccess::get<alternative(Flat, I)>(
+                           std::forward<Variants>(variants))...);
+  }
 
-template <typename... Args>
-struct Next;
-
-template <size_t N, typename T, typename U>
-struct Helper;
-
-template <size_t N, size_t Head, size_t... I1, size_t... I2>
-struct Helper<N, std::index_sequence<I1...>, std::index_sequence<Head, I2...>>
-    : std::conditional_t<
-          sizeof...(I2) != N,
-          Helper<N, std::index_sequence<I1..., Head>,
-                 std::index_sequence<I2...>>,
-          default_integral_constant<typename Concatenation<
-              std::index_sequence<I1..., Head + 1>,
-              typename NullSequence<sizeof...(I2)>::value_type>::value_type>> {
-};
+  template <typename Visitor, size_t Flat>
+  static Result<Visitor> entry(Visitor&& visitor, Variants&&... variants) {
+    return invoke<Visitor, Flat>(std::index_sequence_for<Variants...>(),
+                                 std::forward<Visitor>(visitor),
+                                 std::forward<Variants>(variants)...);
+  }
+
+  template <typename Visitor, size_t... Flat>
+  static constexpr std::array<Entry<Visitor>, count> make_table(
+      std::index_sequence<Flat...>) {
+    return {&entry<Visitor, Flat>...};
+  }
 
-template <size_t... I, typename... Variants>
-struct Next<std::index_sequence<I...>, Variants...>
-    : Helper<Match<std::index_sequence<I...>,
-                   typename VariantSizeSequence<
-                       std::decay_t<Variants>...>::value_type>::value,
-             std::index_sequence<>, std::index_sequence<I...>> {};
-
-template <typename Visitor, size_t... I, typename... Variants>
-auto visit_impl(Visitor&& visitor, const std::index_sequence<I...>&,
-                Variants&&... variants) {
-  if constexpr (!Full<std::index_sequence<I...>, Variants...>::value) {
-    if (((variants.index() == I) && ...)) {
-      return std::invoke(std::forward<Visitor>(visitor),
-                         get<I>(std::forward<Variants>(variants))...);
+  template <typename Visitor>
+  static constexpr std::array<Entry<Visitor>, count> table =
+      make_table<Visitor>(std::make_index_sequence<count>());
+
+  static size_t flat_index(const Variants&... variants) {
+    if ((variants.valueless_by_exception() || ...)) {
+      throw BadVariantAccess();
     }
-    return visit_impl(std::forward<Visitor>(visitor),
-                      Next<std::index_sequence<I...>, Variants...>::value,
-                      std::forward<Variants>(variants)...);
-  } else {
-    return std::invoke(std::forward<Visitor>(visitor),
-                       get<I>(std::forward<Variants>(variants))...);
+    size_t flat = 0;
+    ((flat = flat * VariantSize<std::remove_cvref_t<Variants>>::value +
+             variants.index()),
+     ...);
+    return flat;
   }
-}
+};
 
 template <typename Visitor, typename... Variants>
 auto visit(Visitor&& visitor, Variants&&... variants) {
-  return visit_impl(std::forward<Visitor>(visitor),
-                    make_null_sequence<sizeof...(Variants)>,
-                    std::forward<Variants>(variants)...);
+  using Table = VisitTable<Variants...>;
+  return Table::template table<Visitor>[Table::flat_index(variants...)](
+      std::forward<Visitor>(visitor), std::forward<Variants>(variants)...);
+}
+
+// a column of Variant<Types...> values laid out by alternative: a tag per row
+// and a dense array per type, rows refer to their slot in that array
+template <typename... Types>
+class VariantColumn {
+  using Index = VariantIndex<sizeof...(Types)>;
+
+  template <typename T>
+  static constexpr size_t type_index = get_index_v<T, Types...>;
+
+ public:
+  size_t size() const noexcept {
+    return tags_.size();
+  }
+
+  bool empty() const noexcept {
+    return tags_.empty();
+  }
+
+  size_t index(size_t row) const noexcept {
+    return tags_[row];
+  }
+
+  void reserve(size_t count) {
+    tags_.reserve(count);
+    slots_.reserve(count);
+  }
+
+  template <typename T, typename... Args>
+  T& emplace_back(Args&&... args);
+
+  template <typename T, std::enable_if_t<ContainedInPackage<std::decay_t<T>,
+                                                           Types...>::value,
+                                         bool> = true>
+  void push_back(T&& value) {
+    emplace_back<std::decay_t<T>>(std::forward<T>(value));
+  }
+
+  void push_back(const Variant<Types...>& variant) {
+    ::visit([this](const auto& value) { push_back(value); }, variant);
+  }
+
+  // the last row is always the last element of its dense array
+  void pop_back() noexcept;
+
+  void clear() noexcept;
+
+  template <typename T>
+  T& get(size_t row) {
+    if (tags_[row] != type_index<T>) {
+      throw BadVariantAccess();
+    }
+    return std::get<type_index<T>>(columns_)[slots_[row]];
+  }
+
+  template <typename T>
+  const T& get(size_t row) const {
+    return const_cast<VariantColumn&>(*this).template get<T>(row);
+  }
+
+  // every value of one alternative, in row order
+  template <typename T>
+  std::span<T> values() noexcept {
+    return std::get<type_index<T>>(columns_);
+  }
+
+  template <typename T>
+  std::span<const T> values() const noexcept {
+    return std::get<type_index<T>>(columns_);
+  }
+
+  template <typename Visitor>
+  decltype(auto) visit(size_t row, Visitor&& visitor);
+
+  // runs visitor over each alternative's array in turn, so every loop is
+  // over contiguous values of a single type; rows are not visited in order
+  template <typename Visitor>
+  void visit_batch(Visitor&& visitor);
+
+ private:
+  template <typename Visitor, size_t... I>
+  decltype(auto) visit_row(size_t row, Visitor&& visitor,
+                           std::index_sequence<I...>);
+
+  std::vector<Index> tags_;
+  std::vector<size_t> slots_;
+  std::tuple<std::vector<Types>...> columns_;
+};
+
+template <typename... Types>
+template <typename T, typename... Args>
+T& VariantColumn<Types...>::emplace_back(Args&&... args) {
+  auto& column = std::get<type_index<T>>(columns_);
+  // the index vectors grow first, nothing can throw once the value is in;
+  // reserve(size() + 1) would grow them by one row at a time
+  auto make_room = [](auto& index) {
+    if (index.size() == index.capacity()) {
+      index.reserve(std::max<size_t>(2 * index.capacity(), 1));
+    }
+  };
+  make_room(tags_);
+  make_room(slots_);
+  T& value = column.emplace_back(std::forward<Args>(args)...);
+  tags_.push_back(type_index<T>);
+  slots_.push_back(column.size() - 1);
+  return value;
+}
+
+template <typename... Types>
+void VariantColumn<Types...>::pop_back() noexcept {
+  size_t tag = tags_.back();
+  [&]<size_t... I>(std::index_sequence<I...>) {
+    ((tag == I ? std::get<I>(columns_).pop_back() : void()), ...);
+  }(std::index_sequence_for<Types...>());
+  tags_.pop_back();
+  slots_.pop_back();
+}
+
+template <typename... Types>
+void VariantColumn<Types...>::clear() noexcept {
+  tags_.clear();
+  slots_.clear();
+  std::apply([](auto&... column) { (column.clear(), ...); }, columns_);
+}
+
+template <typename... Types>
+template <typename Visitor>
+decltype(auto) VariantColumn<Types...>::visit(size_t row, Visitor&& visitor) {
+  return visit_row(row, std::forward<Visitor>(visitor),
+                   std::index_sequence_for<Types...>());
+}
+
+template <typename... Types>
+template <typename Visitor, size_t... I>
+decltype(auto) VariantColumn<Types...>::visit_row(size_t row,
+                                                  Visitor&& visitor,
+                                                  std::index_sequence<I...>) {
+  using Result = std::invoke_result_t<Visitor, get_type_t<0, Types...>&>;
+  using Entry = Result (*)(VariantColumn&, size_t, Visitor&&);
+  static constexpr std::array<Entry, sizeof...(Types)> table{
+      [](VariantColumn& column, size_t slot, Visitor&& visitor) -> Result {
+        return std::invoke(std::forward<Visitor>(visitor),
+                           std::get<I>(column.columns_)[slot]);
+      }...};
+  return table[tags_[row]](*this, slots_[row], std::forward<Visitor>(visitor));
+}
+
+template <typename... Types>
+template <typename Visitor>
+void VariantColumn<Types...>::visit_batch(Visitor&& visitor) {
+  std::apply(
+      [&visitor](auto&... column) {
+        auto run = [&visitor](auto& values) {
+          for (auto& value : values) {
+            std::invoke(visitor, value);
+          }
+        };
+        (run(column), ...);
+      },
+      columns_);
 }